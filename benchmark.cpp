@@ -0,0 +1,113 @@
+// Microbenchmarks for the cache access hot paths, reporting accesses per second
+// (items_per_second) for each cache type, access pattern and geometry.
+//
+//   g++ -std=c++17 -O2 -pthread -DSIMULATOR_NO_MAIN -o benchmark benchmark.cpp -lbenchmark
+//   ./benchmark --benchmark_filter=SetAssociative
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "simulator.cpp"
+
+enum class Pattern {
+    HitHeavy,  // Random accesses within a quarter of the (first-level) cache
+    MissHeavy, // Random accesses over 64 times the largest cache
+    Streaming, // Sequential words from a counter that never revisits an address
+    Random     // Random accesses over four times the largest cache
+};
+
+static const char* patternNames[] = {"HitHeavy", "MissHeavy", "Streaming", "Random"};
+
+// Fixed-seed trace replayed in a loop, so the timed loop does not include address
+// generation. Streaming addresses are the access count itself, so the stream never
+// wraps back into cached blocks. A quarter of the accesses are writes.
+struct Trace {
+    static const int length = 1 << 16;
+
+    bool streaming;
+    std::vector<Address> addresses;
+    std::vector<bool> writes;
+
+    // firstLevelWords sizes the hit-heavy range, capacityWords the others
+    Trace(Pattern pattern, long long firstLevelWords, long long capacityWords)
+        : streaming(pattern == Pattern::Streaming), addresses(length), writes(length) {
+        std::mt19937_64 rng(42);
+        long long range = pattern == Pattern::HitHeavy ? firstLevelWords / 4
+                          : pattern == Pattern::MissHeavy ? capacityWords * 64
+                          : capacityWords * 4;
+        for (int i = 0; i < length; ++i) {
+            addresses[i] = rng() % range;
+            writes[i] = rng() % 4 == 0;
+        }
+    }
+
+    Address address(long long n) const {
+        return streaming ? (Address)n : addresses[n & (length - 1)];
+    }
+
+    bool write(long long n) const {
+        return writes[n & (length - 1)];
+    }
+};
+
+// state.range(0) = pattern, 1 = blocks, 2 = block size in words, 3 = ways (unused here)
+static void BM_DirectMapped(benchmark::State& state) {
+    Pattern pattern = (Pattern)state.range(0);
+    int numBlocks = (int)state.range(1);
+    int blockSize = (int)state.range(2);
+    DirectMappedCache cache(numBlocks, blockSize);
+    Trace trace(pattern, (long long)numBlocks * blockSize, (long long)numBlocks * blockSize);
+    long long n = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.access(trace.address(n), trace.write(n)));
+        ++n;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(patternNames[(int)pattern]);
+}
+
+static void BM_SetAssociative(benchmark::State& state) {
+    Pattern pattern = (Pattern)state.range(0);
+    int numBlocks = (int)state.range(1);
+    int blockSize = (int)state.range(2);
+    SetAssociativeCache cache(numBlocks, blockSize, (int)state.range(3));
+    Trace trace(pattern, (long long)numBlocks * blockSize, (long long)numBlocks * blockSize);
+    long long n = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.access(trace.address(n), trace.write(n)));
+        ++n;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(patternNames[(int)pattern]);
+}
+
+// L1 blocks, block size and L2 ways are the arguments; L2 is eight times the L1
+static void BM_TwoLevel(benchmark::State& state) {
+    Pattern pattern = (Pattern)state.range(0);
+    int numBlocks = (int)state.range(1);
+    int blockSize = (int)state.range(2);
+    TwoLevelCache cache(numBlocks, blockSize, numBlocks * 8, blockSize, (int)state.range(3));
+    Trace trace(pattern, (long long)numBlocks * blockSize, (long long)numBlocks * 8 * blockSize);
+    long long n = 0;
+    for (auto _ : state) {
+        cache.access(trace.address(n), trace.write(n));
+        ++n;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(patternNames[(int)pattern]);
+}
+
+static void geometries(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"pattern", "blocks", "block_size", "ways"});
+    for (int pattern = 0; pattern < 4; ++pattern) {
+        bench->Args({pattern, 128, 16, 8});    // The default L1 of main()
+        bench->Args({pattern, 1024, 16, 8});   // The default L2 of main()
+        bench->Args({pattern, 4096, 8, 4});
+        bench->Args({pattern, 32768, 8, 16});
+    }
+}
+
+BENCHMARK(BM_DirectMapped)->Apply(geometries);
+BENCHMARK(BM_SetAssociative)->Apply(geometries);
+BENCHMARK(BM_TwoLevel)->Apply(geometries);
+
+BENCHMARK_MAIN();
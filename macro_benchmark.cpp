@@ -0,0 +1,193 @@
+// End-to-end throughput benchmark: replays fixed synthetic traces through the cache
+// hierarchy of main() and reports simulated accesses per second, peak RSS and the
+// per-level stats, so simulator versions can be compared on identical workloads.
+//
+//   g++ -std=c++17 -O2 -pthread -DSIMULATOR_NO_MAIN -o macro_benchmark macro_benchmark.cpp
+//   ./macro_benchmark [accesses per trace] [trace...]
+//
+// Adding -DSIM_PROFILE also prints each trace's simulator stage profile to stderr.
+//
+// Traces are sequential, strided, zipf, pointer_chase and mixed; every trace runs
+// 10^8 accesses unless a count is given. Only the simulation is timed: traces are
+// generated in chunks outside the timed region. Each trace runs in its own process so
+// the peak RSS is its own.
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "simulator.cpp"
+
+enum class TraceKind {
+    Sequential,   // Reads of consecutive words
+    Strided,      // Reads four blocks apart, wrapping around the address range
+    Zipf,         // Zipfian block popularity (s = 0.99), 30% writes
+    PointerChase, // Reads following a random cycle through the blocks
+    Mixed         // Read-then-write of each word over sliding windows, as in main()
+};
+
+static const char* traceNames[] = {"sequential", "strided", "zipf", "pointer_chase", "mixed"};
+static const int traceCount = 5;
+
+// Deterministic trace source; the same kind always yields the same addresses
+class TraceGenerator {
+private:
+    static const int blockWords = 16;
+    static const int numBlocks = 1 << 20; // 16M words of address space
+
+    TraceKind kind;
+    long long position;
+    std::mt19937_64 rng;
+    std::vector<double> zipfCdf;
+    std::vector<int> nextBlock; // Pointer chase successor of each block
+    int chaseBlock;
+
+public:
+    explicit TraceGenerator(TraceKind kind) : kind(kind), position(0), rng(42), chaseBlock(0) {
+        if (kind == TraceKind::Zipf) {
+            zipfCdf.resize(numBlocks);
+            double sum = 0.0;
+            for (int i = 0; i < numBlocks; ++i) {
+                sum += 1.0 / std::pow(i + 1, 0.99);
+                zipfCdf[i] = sum;
+            }
+            for (double& value : zipfCdf) {
+                value /= sum;
+            }
+        } else if (kind == TraceKind::PointerChase) {
+            // Sattolo's algorithm gives a single cycle through every block
+            nextBlock.resize(numBlocks);
+            std::iota(nextBlock.begin(), nextBlock.end(), 0);
+            for (int i = numBlocks - 1; i > 0; --i) {
+                std::swap(nextBlock[i], nextBlock[rng() % i]);
+            }
+        }
+    }
+
+    void fill(std::vector<Address>& addresses, std::vector<char>& writes) {
+        const long long rangeWords = (long long)numBlocks * blockWords;
+        for (size_t i = 0; i < addresses.size(); ++i, ++position) {
+            Address address = 0;
+            bool write = false;
+            switch (kind) {
+            case TraceKind::Sequential:
+                address = position % rangeWords;
+                break;
+            case TraceKind::Strided: {
+                long long stride = 4 * blockWords;
+                long long step = position * stride;
+                address = step % rangeWords + step / rangeWords % stride;
+                break;
+            }
+            case TraceKind::Zipf: {
+                double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+                long long rank = std::lower_bound(zipfCdf.begin(), zipfCdf.end(), u) - zipfCdf.begin();
+                // Scatter popular blocks over the address space
+                long long block = (rank * 0x9E3779B1LL) & (numBlocks - 1);
+                address = block * blockWords + rng() % blockWords;
+                write = rng() % 10 < 3;
+                break;
+            }
+            case TraceKind::PointerChase:
+                address = (long long)chaseBlock * blockWords + position % blockWords;
+                if (position % blockWords == blockWords - 1) {
+                    chaseBlock = nextBlock[chaseBlock];
+                }
+                break;
+            case TraceKind::Mixed: {
+                // Windows of 4000 words advancing by 2000, each word read then written
+                long long pass = position / 8000;
+                long long offset = position % 8000;
+                address = (pass * 2000 + offset / 2) % rangeWords;
+                write = offset % 2 == 1;
+                break;
+            }
+            }
+            addresses[i] = address;
+            writes[i] = write;
+        }
+    }
+};
+
+static long peakRssKB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void runTrace(TraceKind kind, long long accesses) {
+    const int chunk = 1 << 16;
+    TwoLevelCache cache(128, 16, 1024, 16, 8);
+    TraceGenerator generator(kind);
+    std::vector<Address> addresses(chunk);
+    std::vector<char> writes(chunk);
+    std::chrono::steady_clock::duration elapsed(0);
+
+    for (long long done = 0; done < accesses; done += chunk) {
+        int count = (int)std::min<long long>(chunk, accesses - done);
+        SIM_PROFILE_STAGE(TraceDecode);
+        generator.fill(addresses, writes);
+        SIM_PROFILE_STAGE(Outside);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            cache.access(addresses[i], writes[i]);
+        }
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    const Cache& l1 = cache.getL1Cache();
+    const Cache& l2 = cache.getL2Cache();
+    std::cout << "Trace: " << traceNames[(int)kind] << std::endl;
+    std::cout << "Accesses: " << accesses << std::endl;
+    std::cout << "Simulation Time: " << seconds << " s" << std::endl;
+    std::cout << "Throughput: " << (long long)(seconds > 0 ? accesses / seconds : 0.0) << " accesses/s" << std::endl;
+    std::cout << "Peak RSS: " << peakRssKB() << " KB" << std::endl;
+    std::cout << "L1 Miss Rate: " << (double)l1.getMisses() / l1.getSearches() * 100 << "%" << std::endl;
+    std::cout << "L2 Miss Rate: " << (l2.getSearches() ? (double)l2.getMisses() / l2.getSearches() * 100 : 0.0) << "%" << std::endl;
+    std::cout << "L1 Writebacks: " << l1.getWritebacks() << std::endl;
+    std::cout << "L2 Writebacks: " << l2.getWritebacks() << std::endl;
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    long long accesses = 100000000;
+    std::vector<TraceKind> kinds;
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] >= '0' && argv[i][0] <= '9') {
+            accesses = std::atoll(argv[i]);
+            continue;
+        }
+        int kind = 0;
+        while (kind < traceCount && std::strcmp(argv[i], traceNames[kind]) != 0) {
+            kind++;
+        }
+        if (kind == traceCount) {
+            std::cerr << "Unknown trace: " << argv[i] << std::endl;
+            return 1;
+        }
+        kinds.push_back((TraceKind)kind);
+    }
+    if (kinds.empty()) {
+        for (int kind = 0; kind < traceCount; ++kind) {
+            kinds.push_back((TraceKind)kind);
+        }
+    }
+
+    for (TraceKind kind : kinds) {
+        pid_t child = fork();
+        if (child == 0) {
+            runTrace(kind, accesses);
+            std::exit(0);
+        }
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) < 0 || status != 0) {
+            std::cerr << "Trace " << traceNames[(int)kind] << " failed" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,350 +1,4419 @@
 #include <iostream>
 #include <vector>
 #include <climits>
-#include <queue>
 #include <unordered_map>
 #include <functional> // Include for std::function
+#include <memory>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#ifdef SIM_PROFILE
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
+#ifdef SIM_PROFILE
+enum class ProfileStage {
+    Outside, // Host time outside the marked simulator paths
+    TraceDecode,
+    L1Lookup,
+    BufferSearch, // Victim cache, write buffer and prefetch cache
+    L2Lookup,
+    Prefetch,
+    StatsUpdate,
+    Timing // Event processing, memory latency and cycle accounting
+};
+
+// Host time spent in each stage of the simulator itself. A stage runs from its
+// SIM_PROFILE_STAGE mark to the next mark, so each mark costs one timestamp read
+// (rdtsc on x86, steady_clock elsewhere). SIM_PROFILE_SCOPE marks a stage nested in
+// another, such as a prefetch issued during a cache lookup, and resumes the enclosing
+// stage when the scope ends. The breakdown goes to stderr at exit.
+// Only the sequential paths are marked; the profiler is not thread-safe.
+class SimProfiler {
+private:
+    static const int stageCount = 8;
+
+    unsigned long long ticks[stageCount];
+    long long entries[stageCount];
+    ProfileStage current;
+    unsigned long long last;
+
+    static unsigned long long now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+public:
+    SimProfiler() : ticks(), entries(), current(ProfileStage::Outside), last(now()) {}
+
+    ~SimProfiler() {
+        report();
+    }
+
+    void enter(ProfileStage stage) {
+        entries[(int)stage]++;
+        resume(stage);
+    }
+
+    // Switches back to a stage without counting a new entry into it
+    void resume(ProfileStage stage) {
+        unsigned long long time = now();
+        ticks[(int)current] += time - last;
+        current = stage;
+        last = time;
+    }
+
+    ProfileStage stage() const {
+        return current;
+    }
+
+    void report() const {
+        static const char* stageNames[] = {"Outside", "Trace Decode", "L1 Lookup", "Buffer Search",
+                                           "L2 Lookup", "Prefetch", "Stats Update", "Timing"};
+        unsigned long long total = 0;
+        for (int i = 1; i < stageCount; ++i) {
+            total += ticks[i];
+        }
+        if (total == 0) {
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        const char* unit = "TSC ticks";
+#else
+        const char* unit = "ns";
+#endif
+        std::cerr << "Simulator Profile (" << unit << "):" << std::endl;
+        for (int i = 1; i < stageCount; ++i) {
+            std::cerr << stageNames[i] << ": " << ticks[i] << " (" << (double)ticks[i] / total * 100
+                      << "%, " << entries[i] << " entries)" << std::endl;
+        }
+        long long accesses = entries[(int)ProfileStage::L1Lookup];
+        if (accesses > 0) {
+            unsigned long long accessTicks = total - ticks[(int)ProfileStage::TraceDecode];
+            std::cerr << "Per Access (excluding trace decode): " << (double)accessTicks / accesses << std::endl;
+        }
+        std::cerr << "Outside: " << ticks[0] << std::endl;
+    }
+};
+
+SimProfiler simProfiler;
+
+class SimProfileScope {
+private:
+    ProfileStage outer;
+
+public:
+    explicit SimProfileScope(ProfileStage stage) : outer(simProfiler.stage()) {
+        simProfiler.enter(stage);
+    }
+
+    ~SimProfileScope() {
+        simProfiler.resume(outer);
+    }
+};
+
+#define SIM_PROFILE_STAGE(stage) simProfiler.enter(ProfileStage::stage)
+#define SIM_PROFILE_SCOPE(stage) SimProfileScope simProfileScope(ProfileStage::stage)
+#else
+#define SIM_PROFILE_STAGE(stage) ((void)0)
+#define SIM_PROFILE_SCOPE(stage) ((void)0)
+#endif
+
+// Memory addresses are 64-bit. They count 64-bit words by default; byte addressing
+// (setAddressMode) replays traces of real byte addresses.
+using Address = std::uint64_t;
+const Address InvalidAddress = ~Address(0);
+
+enum class AddressMode {
+    Word, // Addresses count 64-bit words
+    Byte  // Addresses count bytes
+};
+
+const int wordBytes = 8;
+
+// Bits of an address below the block address, for blocks of blockSize words
+inline int blockOffsetBits(int blockSize, AddressMode mode) {
+    int units = mode == AddressMode::Byte ? blockSize * wordBytes : blockSize;
+    int bits = 0;
+    while ((1 << bits) < units) {
+        bits++;
+    }
+    return bits;
+}
 
 class CacheBlock {
 public:
     bool valid;
     bool dirty;
-    int tag;
-    int lastAccessTime;
-    std::vector<long long> data; // 64-bit words
+    bool prefetched; // Filled by a prefetch and not yet demanded
+    Address tag; // Block address bits above the set index; the whole block address in buffers
+    long long lastAccessTime;
+    long long prefetchTime; // Time the prefetch was issued
 
-    CacheBlock(int blockSize = 16) { // Default constructor with default block size
+    // Only the metadata is modelled; block contents are never simulated
+    CacheBlock() {
         valid = false;
         dirty = false;
-        tag = -1;
+        prefetched = false;
+        tag = InvalidAddress;
         lastAccessTime = 0;
-        data.resize(blockSize);
+        prefetchTime = 0;
     }
 };
 
-class Cache {
-protected:
-    std::vector<CacheBlock> cache;
-    int numBlocks;
-    int blockSize;
-    int currentTime;
-    int cacheMisses;
-    int readMisses;
-    int writeMisses;
-    int cacheSearches;
+// Feedback-directed prefetch throttling. Usefulness, lateness and pollution are
+// sampled over fixed intervals of demand misses and the prefetch degree is raised
+// or lowered accordingly. A degree of 0 turns prefetching off until the next probe.
+class PrefetchThrottle {
+private:
+    bool enabled;
+    int degree;
+    int maxDegree;
+    int interval; // Demand misses per evaluation
+    int intervalMisses;
+    int intervalIssued;
+    int intervalUseful;
+    int intervalLate;
+    int intervalPolluted;
 
 public:
-    Cache(int numBlocks, int blockSize) : numBlocks(numBlocks), blockSize(blockSize), currentTime(0),
-        cacheMisses(0), readMisses(0), writeMisses(0), cacheSearches(0) {
-        cache.resize(numBlocks, CacheBlock(blockSize));
-    }
-
-    virtual bool access(int memoryAddress, bool write) = 0; // Pure virtual function
+    PrefetchThrottle(int degree = 1, int maxDegree = 4, int interval = 256)
+        : enabled(false), degree(degree), maxDegree(maxDegree), interval(interval), intervalMisses(0),
+          intervalIssued(0), intervalUseful(0), intervalLate(0), intervalPolluted(0) {}
 
-    int getMisses() const {
-        return cacheMisses;
+    void enable(bool on) {
+        enabled = on;
     }
 
-    int getSearches() const {
-        return cacheSearches;
+    int getDegree() const {
+        return degree;
     }
 
-    int getBlockSize() const {
-        return blockSize;
+    // Caps a prefetcher's request count at the current degree while throttling is on
+    int limit(int requested) const {
+        return (enabled && requested > degree) ? degree : requested;
     }
 
-    void printStats(const std::string& cacheName) const {
-        std::cout << cacheName << " Cache Stats:" << std::endl;
-        std::cout << "Cache Misses: " << cacheMisses << std::endl;
-        std::cout << "Cache Searches: " << cacheSearches << std::endl;
-        std::cout << "Cache Hit Rate: " << (1.0 - (double)cacheMisses / cacheSearches) * 100 << "%" << std::endl;
-        std::cout << "Read Misses: " << readMisses << std::endl;
-        std::cout << "Write Misses: " << writeMisses << std::endl;
+    void recordIssued() {
+        intervalIssued++;
     }
-};
 
-class DirectMappedCache : public Cache {
-public:
-    std::function<void(const CacheBlock&)> onEvict; // Callback for eviction
-
-    DirectMappedCache(int numBlocks, int blockSize) : Cache(numBlocks, blockSize) {}
+    void recordUseful(bool late) {
+        intervalUseful++;
+        if (late) {
+            intervalLate++;
+        }
+    }
 
-    bool access(int memoryAddress, bool write) override {
-        currentTime++;
-        cacheSearches++;
+    void recordPollution() {
+        intervalPolluted++;
+    }
 
-        int blockOffsetBits = 4; // Block size is 16 words (64 bytes), so 4 bits for offset
-        int index = (memoryAddress >> blockOffsetBits) % numBlocks;
-        int tag = memoryAddress >> blockOffsetBits;
+    void recordMiss() {
+        if (!enabled || ++intervalMisses < interval) {
+            return;
+        }
 
-        if (cache[index].valid && cache[index].tag == tag) {
-            // Cache hit
-            cache[index].lastAccessTime = currentTime;
-            if (write) {
-                cache[index].dirty = true;
-            }
-            return true; // Hit
+        if (degree == 0) {
+            degree = 1; // Probe again after a disabled interval
         } else {
-            // Cache miss
-            cacheMisses++;
-            if (write) {
-                writeMisses++;
-            } else {
-                readMisses++;
-            }
-
-            // Evict the current block (if valid, notify TwoLevelCache to add to victim cache)
-            if (cache[index].valid && onEvict) {
-                onEvict(cache[index]); // Trigger the eviction callback
-            }
+            double accuracy = intervalIssued ? (double)intervalUseful / intervalIssued : 0.0;
+            double lateness = intervalUseful ? (double)intervalLate / intervalUseful : 0.0;
+            double pollution = intervalIssued ? (double)intervalPolluted / intervalIssued : 0.0;
 
-            // Replace the block
-            cache[index].valid = true;
-            cache[index].tag = tag;
-            cache[index].lastAccessTime = currentTime;
-            if (write) {
-                cache[index].dirty = true;
+            if (accuracy >= 0.75) {
+                if (lateness > 0.01 && degree < maxDegree) {
+                    degree++;
+                }
+            } else if (accuracy >= 0.40) {
+                if (lateness > 0.01 && degree < maxDegree) {
+                    degree++;
+                } else if (pollution > 0.005) {
+                    degree--;
+                }
             } else {
-                cache[index].dirty = false;
+                degree--;
             }
-            return false; // Miss
         }
+
+        intervalMisses = 0;
+        intervalIssued = 0;
+        intervalUseful = 0;
+        intervalLate = 0;
+        intervalPolluted = 0;
     }
 };
 
-class SetAssociativeCache : public Cache {
+// Open-addressed map from block tag to buffer slot. The table is sized once at
+// construction, so lookups, inserts and erases never allocate.
+class TagIndex {
 private:
-    int ways;
-    std::vector<std::vector<CacheBlock>> sets;
-    std::vector<std::unordered_map<int, int>> tagToIndex; // Maps tag to index in the set
-    std::unordered_map<int, int> accessFrequency; // Tracks access frequency for prefetching
+    std::vector<Address> keys; // InvalidAddress marks an empty bucket
+    std::vector<int> values;
+    int mask;
 
-public:
-    SetAssociativeCache(int numBlocks, int blockSize, int ways) : Cache(numBlocks, blockSize), ways(ways) {
-        int numSets = numBlocks / ways;
-        sets.resize(numSets, std::vector<CacheBlock>(ways, CacheBlock(blockSize)));
-        tagToIndex.resize(numSets);
+    int bucket(Address tag) const {
+        return (int)((tag * 0x9E3779B97F4A7C15ull) >> 32) & mask;
     }
 
-    bool access(int memoryAddress, bool write) override {
-        currentTime++;
-        cacheSearches++;
-
-        int blockOffsetBits = 4; // Block size is 16 words (64 bytes), so 4 bits for offset
-        int setIndex = (memoryAddress >> blockOffsetBits) % sets.size();
-        int tag = memoryAddress >> blockOffsetBits;
+public:
+    TagIndex(int capacity = 4) {
+        int size = 1;
+        while (size < capacity * 2) {
+            size <<= 1;
+        }
+        keys.resize(size, InvalidAddress);
+        values.resize(size, 0);
+        mask = size - 1;
+    }
 
-        if (tagToIndex[setIndex].find(tag) != tagToIndex[setIndex].end()) {
-            // Cache hit
-            int blockIndex = tagToIndex[setIndex][tag];
-            sets[setIndex][blockIndex].lastAccessTime = currentTime;
-            if (write) {
-                sets[setIndex][blockIndex].dirty = true;
+    int find(Address tag) const {
+        for (int i = bucket(tag);; i = (i + 1) & mask) {
+            if (keys[i] == tag) {
+                return values[i];
             }
-            return true; // Hit
-        } else {
-            // Cache miss
-            cacheMisses++;
-            if (write) {
-                writeMisses++;
-            } else {
-                readMisses++;
+            if (keys[i] == InvalidAddress) {
+                return -1;
             }
+        }
+    }
 
-            // Prefetch the next block
-            int nextAddress = memoryAddress + (1 << blockOffsetBits);
-            prefetch(nextAddress);
-
-            // Find the LRU block in the set
-            int lruIndex = 0;
-            int minTime = INT_MAX;
-            for (int i = 0; i < ways; ++i) {
-                if (!sets[setIndex][i].valid || sets[setIndex][i].lastAccessTime < minTime) {
-                    lruIndex = i;
-                    minTime = sets[setIndex][i].lastAccessTime;
-                }
-            }
+    void insert(Address tag, int value) {
+        int i = bucket(tag);
+        while (keys[i] != InvalidAddress && keys[i] != tag) {
+            i = (i + 1) & mask;
+        }
+        keys[i] = tag;
+        values[i] = value;
+    }
 
-            // Replace the LRU block
-            if (sets[setIndex][lruIndex].valid && sets[setIndex][lruIndex].dirty) {
-                // Write back to memory if dirty
+    void erase(Address tag) {
+        int i = bucket(tag);
+        while (keys[i] != tag) {
+            if (keys[i] == InvalidAddress) {
+                return;
             }
-            sets[setIndex][lruIndex].valid = true;
-            sets[setIndex][lruIndex].tag = tag;
-            sets[setIndex][lruIndex].lastAccessTime = currentTime;
-            if (write) {
-                sets[setIndex][lruIndex].dirty = true;
-            } else {
-                sets[setIndex][lruIndex].dirty = false;
+            i = (i + 1) & mask;
+        }
+        // Backward-shift deletion keeps probe chains intact without tombstones
+        for (int j = (i + 1) & mask; keys[j] != InvalidAddress; j = (j + 1) & mask) {
+            int home = bucket(keys[j]);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                keys[i] = keys[j];
+                values[i] = values[j];
+                i = j;
             }
-            tagToIndex[setIndex][tag] = lruIndex;
-            return false; // Miss
         }
+        keys[i] = InvalidAddress;
     }
+};
 
-    void prefetch(int memoryAddress) {
-        int blockOffsetBits = 4; // Block size is 16 words (64 bytes), so 4 bits for offset
-        int setIndex = (memoryAddress >> blockOffsetBits) % sets.size();
-        int tag = memoryAddress >> blockOffsetBits;
+// Growable open-addressed set of block addresses (InvalidAddress is not stored)
+class BlockSet {
+private:
+    std::vector<Address> keys; // InvalidAddress marks an empty bucket
+    int count;
+    int mask;
 
-        if (tagToIndex[setIndex].find(tag) == tagToIndex[setIndex].end()) {
-            // Prefetch the block into the cache
-            int lruIndex = 0;
-            int minTime = INT_MAX;
-            for (int i = 0; i < ways; ++i) {
-                if (!sets[setIndex][i].valid || sets[setIndex][i].lastAccessTime < minTime) {
-                    lruIndex = i;
-                    minTime = sets[setIndex][i].lastAccessTime;
+    int bucket(Address key) const {
+        return (int)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    void grow() {
+        std::vector<Address> old;
+        old.swap(keys);
+        keys.resize(old.size() * 2, InvalidAddress);
+        mask = (int)keys.size() - 1;
+        for (Address key : old) {
+            if (key != InvalidAddress) {
+                int i = bucket(key);
+                while (keys[i] != InvalidAddress) {
+                    i = (i + 1) & mask;
                 }
+                keys[i] = key;
             }
+        }
+    }
 
-            // Replace the LRU block
-            if (sets[setIndex][lruIndex].valid && sets[setIndex][lruIndex].dirty) {
-                // Write back to memory if dirty
+public:
+    BlockSet(int capacity = 16) : count(0) {
+        int size = 1;
+        while (size < capacity * 2) {
+            size <<= 1;
+        }
+        keys.resize(size, InvalidAddress);
+        mask = size - 1;
+    }
+
+    // Returns true if the key was not already present
+    bool insert(Address key) {
+        int i = bucket(key);
+        while (keys[i] != InvalidAddress) {
+            if (keys[i] == key) {
+                return false;
             }
-            sets[setIndex][lruIndex].valid = true;
-            sets[setIndex][lruIndex].tag = tag;
-            sets[setIndex][lruIndex].lastAccessTime = currentTime;
-            sets[setIndex][lruIndex].dirty = false;
-            tagToIndex[setIndex][tag] = lruIndex;
+            i = (i + 1) & mask;
+        }
+        keys[i] = key;
+        if (++count * 2 > (int)keys.size()) {
+            grow();
         }
+        return true;
+    }
+
+    int size() const {
+        return count;
     }
 };
 
-class TwoLevelCache {
+// Fixed-capacity recency list of block tags with O(1) lookup, touch and eviction: a
+// tag index over slots linked into an array-based doubly-linked list, most recently
+// used first.
+class LRUList {
 private:
-    DirectMappedCache l1Cache;
-    SetAssociativeCache l2Cache;
-    std::queue<CacheBlock> writeBuffer;
-    std::vector<CacheBlock> victimCache;
-    std::vector<CacheBlock> prefetchCache;
-    std::unordered_map<int, int> accessFrequency; // Tracks access frequency for prefetching
-
-    int unifiedHits;
-    int unifiedMisses;
+    std::vector<Address> tags;
+    std::vector<int> prev;
+    std::vector<int> next;
+    TagIndex index;
+    int head; // Most recently used slot, -1 when empty
+    int tail; // Least recently used slot
+    int used;
 
-    void addToVictimCache(const CacheBlock& block) {
-        if (victimCache.size() >= 4) {
-            // Evict the oldest block
-            victimCache.erase(victimCache.begin());
+    void unlink(int slot) {
+        if (prev[slot] >= 0) {
+            next[prev[slot]] = next[slot];
+        } else {
+            head = next[slot];
         }
-        victimCache.push_back(block);
-    }
-
-    void addToWriteBuffer(const CacheBlock& block) {
-        if (writeBuffer.size() >= 4) {
-            // Write back the oldest block to memory
-            writeBuffer.pop();
+        if (next[slot] >= 0) {
+            prev[next[slot]] = prev[slot];
+        } else {
+            tail = prev[slot];
         }
-        writeBuffer.push(block);
     }
 
-    void addToPrefetchCache(const CacheBlock& block) {
-        if (prefetchCache.size() >= 4) {
-            // Evict the least recently used block
-            prefetchCache.erase(prefetchCache.begin());
+    void pushFront(int slot) {
+        prev[slot] = -1;
+        next[slot] = head;
+        if (head >= 0) {
+            prev[head] = slot;
+        } else {
+            tail = slot;
         }
-        prefetchCache.push_back(block);
+        head = slot;
     }
 
 public:
-    TwoLevelCache(int l1NumBlocks, int l1BlockSize, int l2NumBlocks, int l2BlockSize, int l2Ways)
-        : l1Cache(l1NumBlocks, l1BlockSize), l2Cache(l2NumBlocks, l2BlockSize, l2Ways),
-          unifiedHits(0), unifiedMisses(0) {
-        victimCache.resize(0);
-        prefetchCache.resize(0);
+    LRUList(int capacity = 0)
+        : tags(capacity, InvalidAddress), prev(capacity, -1), next(capacity, -1), index(capacity > 0 ? capacity : 1),
+          head(-1), tail(-1), used(0) {}
 
-        // Set up the eviction callback for L1 cache
-        l1Cache.onEvict = [this](const CacheBlock& block) {
-            addToVictimCache(block);
-        };
+    int capacity() const {
+        return (int)tags.size();
     }
 
-    void access(int memoryAddress, bool write) {
-        bool isUnifiedHit = false;
+    int size() const {
+        return used;
+    }
 
-        // Check L1 cache
-        if (l1Cache.access(memoryAddress, write)) {
-            isUnifiedHit = true;
+    // Slot holding tag, or -1
+    int find(Address tag) const {
+        return index.find(tag);
+    }
+
+    Address tagAt(int slot) const {
+        return tags[slot];
+    }
+
+    // Least recently used slot, -1 when empty
+    int lru() const {
+        return tail;
+    }
+
+    void touch(int slot) {
+        if (slot != head) {
+            unlink(slot);
+            pushFront(slot);
+        }
+    }
+
+    // Inserts tag as most recently used and returns its slot; when full, the least
+    // recently used tag is evicted and stored in *evictedTag (InvalidAddress if nothing
+    // was evicted)
+    int insert(Address tag, Address* evictedTag = nullptr) {
+        int slot;
+        if (evictedTag) {
+            *evictedTag = InvalidAddress;
+        }
+        if (used < capacity()) {
+            slot = used++;
         } else {
-            // Check victim cache
-            for (auto& block : victimCache) {
-                if (block.valid && block.tag == (memoryAddress >> 4)) {
-                    isUnifiedHit = true;
-                    break;
-                }
+            slot = tail;
+            if (evictedTag) {
+                *evictedTag = tags[slot];
             }
+            index.erase(tags[slot]);
+            unlink(slot);
+        }
+        tags[slot] = tag;
+        index.insert(tag, slot);
+        pushFront(slot);
+        return slot;
+    }
 
-            if (!isUnifiedHit) {
-                // Check write buffer
-                std::queue<CacheBlock> tempQueue = writeBuffer;
-                while (!tempQueue.empty()) {
-                    if (tempQueue.front().valid && tempQueue.front().tag == (memoryAddress >> 4)) {
-                        isUnifiedHit = true;
-                        break;
-                    }
-                    tempQueue.pop();
-                }
+    // Removes tag and returns the slot it held (-1 if absent). Slots stay packed: the
+    // entry in the last occupied slot, numbered size() after the call, moves into the
+    // freed one.
+    int erase(Address tag) {
+        int slot = index.find(tag);
+        if (slot < 0) {
+            return -1;
+        }
+        index.erase(tag);
+        unlink(slot);
+        // Keep slots [0, used) occupied by moving the last one into the hole
+        int last = --used;
+        if (slot != last) {
+            tags[slot] = tags[last];
+            prev[slot] = prev[last];
+            next[slot] = next[last];
+            if (prev[slot] >= 0) {
+                next[prev[slot]] = slot;
+            } else {
+                head = slot;
+            }
+            if (next[slot] >= 0) {
+                prev[next[slot]] = slot;
+            } else {
+                tail = slot;
+            }
+            index.insert(tags[slot], slot);
+        }
+        return slot;
+    }
+};
 
-                if (!isUnifiedHit) {
-                    // Check prefetch cache
-                    for (auto& block : prefetchCache) {
-                        if (block.valid && block.tag == (memoryAddress >> 4)) {
-                            isUnifiedHit = true;
-                            break;
-                        }
-                    }
+// Named statistics for machine-readable dumps. Components register pointers to their
+// live counters (or functions for derived values), so a dump always shows current
+// values; the registering objects must outlive the registry. Names are dotted paths
+// such as "l1.misses".
+class StatsRegistry {
+private:
+    struct Entry {
+        std::string name;
+        const long long* value;
+        std::function<long long()> counter;
+        std::function<double()> ratio;
+        bool gauge; // A level rather than a running total
+    };
 
-                    if (!isUnifiedHit) {
-                        // Check L2 cache
-                        if (l2Cache.access(memoryAddress, write)) {
-                            isUnifiedHit = true;
-                        }
-                    }
-                }
+    std::vector<Entry> entries;
+
+    static long long countOf(const Entry& entry) {
+        return entry.value ? *entry.value : entry.counter();
+    }
+
+    void writeValue(std::ostream& out, const Entry& entry) const {
+        if (!entry.ratio) {
+            out << countOf(entry);
+        } else {
+            double value = entry.ratio();
+            if (std::isfinite(value)) {
+                out << value;
+            } else {
+                out << "null";
             }
         }
+    }
 
-        // Update access frequency for prefetching
-        accessFrequency[memoryAddress >> 4]++;
-        if (accessFrequency[memoryAddress >> 4] >= 2) {
-            // Add to prefetch cache if accessed 2 or more times
-            CacheBlock block(l1Cache.getBlockSize());
-            block.valid = true;
-            block.tag = memoryAddress >> 4;
-            addToPrefetchCache(block);
+public:
+    void add(const std::string& name, const long long* value) {
+        entries.push_back(Entry{name, value, nullptr, nullptr, false});
+    }
+
+    void addCounter(const std::string& name, std::function<long long()> value) {
+        entries.push_back(Entry{name, nullptr, std::move(value), nullptr, false});
+    }
+
+    // A value that is not a running total (a current setting or a peak), which
+    // interval sampling reports as is rather than as a per-interval increment
+    void addGauge(const std::string& name, std::function<long long()> value) {
+        entries.push_back(Entry{name, nullptr, std::move(value), nullptr, true});
+    }
+
+    void addRatio(const std::string& name, std::function<double()> value) {
+        entries.push_back(Entry{name, nullptr, nullptr, std::move(value), false});
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    const std::string& getName(size_t i) const {
+        return entries[i].name;
+    }
+
+    bool isRatio(size_t i) const {
+        return (bool)entries[i].ratio;
+    }
+
+    bool isGauge(size_t i) const {
+        return entries[i].gauge;
+    }
+
+    // Current value of a counter or gauge entry
+    long long getCount(size_t i) const {
+        return countOf(entries[i]);
+    }
+
+    // One flat object keyed by statistic name
+    void writeJSON(std::ostream& out) const {
+        out << "{";
+        for (size_t i = 0; i < entries.size(); ++i) {
+            out << (i ? ",\n  \"" : "\n  \"") << entries[i].name << "\": ";
+            writeValue(out, entries[i]);
         }
+        out << "\n}\n";
+    }
 
-        // Handle write misses
-        if (!isUnifiedHit && write) {
-            CacheBlock block(l1Cache.getBlockSize());
-            block.valid = true;
-            block.tag = memoryAddress >> 4;
-            block.dirty = true;
-            addToWriteBuffer(block);
+    // A name,value header followed by one line per statistic
+    void writeCSV(std::ostream& out) const {
+        out << "name,value\n";
+        for (const auto& entry : entries) {
+            out << entry.name << ',';
+            writeValue(out, entry);
+            out << '\n';
         }
+    }
+};
 
-        if (isUnifiedHit) {
-            unifiedHits++;
+// 3C miss classification against a shadow fully-associative LRU cache of the same
+// capacity: a miss to a block never referenced before is compulsory, a miss the
+// shadow also takes is a capacity miss, and the remaining misses are conflict misses.
+// The shadow sees the same demand reference stream as the real cache.
+class MissClassifier {
+private:
+    LRUList shadow;
+    BlockSet seen;
+    bool enabled;
+    long long compulsoryMisses;
+    long long capacityMisses;
+    long long conflictMisses;
+
+public:
+    MissClassifier(int numBlocks = 0)
+        : shadow(numBlocks), seen(numBlocks > 0 ? numBlocks : 1), enabled(numBlocks > 0),
+          compulsoryMisses(0), capacityMisses(0), conflictMisses(0) {}
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    // Records a demand access to blockAddress that the real cache hit or missed
+    void access(Address blockAddress, bool hit) {
+        bool firstReference = seen.insert(blockAddress);
+        int slot = shadow.find(blockAddress);
+        bool shadowHit = slot >= 0;
+        if (shadowHit) {
+            shadow.touch(slot);
         } else {
-            unifiedMisses++;
+            shadow.insert(blockAddress);
+        }
+        if (hit) {
+            return;
+        }
+        if (firstReference) {
+            compulsoryMisses++;
+        } else if (!shadowHit) {
+            capacityMisses++;
+        } else {
+            conflictMisses++;
         }
     }
 
-    void printStats() const {
-        // std::cout << "L1 Cache Stats:" << std::endl;
-        l1Cache.printStats("L1");
+    // True if the shadow cache still holds the block
+    bool contains(Address blockAddress) const {
+        return shadow.find(blockAddress) >= 0;
+    }
 
-        // std::cout << "L2 Cache Stats:" << std::endl;
-        l2Cache.printStats("L2");
+    long long getCompulsoryMisses() const {
+        return compulsoryMisses;
+    }
 
-        std::cout << "Overall Unified Cache Stats:" << std::endl;
-        std::cout << "Unified Hits: " << unifiedHits << std::endl;
-        std::cout << "Unified Misses: " << unifiedMisses << std::endl;
-        std::cout << "Unified Hit Rate: " << (double)unifiedHits / (unifiedHits + unifiedMisses) * 100 << "%" << std::endl;
+    long long getCapacityMisses() const {
+        return capacityMisses;
+    }
+
+    long long getConflictMisses() const {
+        return conflictMisses;
+    }
+
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        registry.add(prefix + ".compulsory_misses", &compulsoryMisses);
+        registry.add(prefix + ".capacity_misses", &capacityMisses);
+        registry.add(prefix + ".conflict_misses", &conflictMisses);
+    }
+};
+
+enum class WriteHitPolicy {
+    WriteBack,   // Mark the block dirty, write it to the next level on eviction
+    WriteThrough // Forward every write to the next level, blocks stay clean
+};
+
+enum class WriteMissPolicy {
+    WriteAllocate,  // Fetch the block and then write it
+    NoWriteAllocate // Forward the write to the next level without allocating
+};
+
+enum class IndexFunction {
+    Modulo,      // Block address modulo the set count
+    XorFold,     // XOR of successive index-width fields of the block address
+    PrimeModulo, // Block address modulo the largest prime not above the set count
+    Skewed       // A different XOR/rotate hash per way (skewed-associative)
+};
+
+// Splits block addresses into a set index and a tag, and rebuilds block addresses
+// from the two. Modulo and PrimeModulo divide the block address by the set count (or
+// the prime); the remainder is the set and the quotient the tag. XorFold and Skewed
+// use the largest power-of-two number of sets, take the bits above the index as the
+// tag and hash them into the index, so the index bits can be recovered from the tag.
+class SetIndexer {
+private:
+    IndexFunction function;
+    int numSets;
+    int modulus; // Largest prime <= numSets for PrimeModulo, numSets otherwise
+    int bits; // Index width: the largest b with 2^b <= numSets
+    Address mask;
+    bool powerOfTwo; // numSets == 2^bits, so Modulo can shift and mask
+
+    static bool isPrime(int n) {
+        if (n < 2) {
+            return false;
+        }
+        for (int d = 2; d * d <= n; ++d) {
+            if (n % d == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // XOR of the index-width fields of value
+    Address fold(Address value) const {
+        Address folded = 0;
+        for (; value != 0; value >>= bits) {
+            folded ^= value;
+        }
+        return folded & mask;
+    }
+
+    // Low index field of the tag rotated by the way number
+    Address skew(Address tag, int way) const {
+        Address field = tag & mask;
+        int shift = way % bits;
+        return ((field << shift) | (field >> (bits - shift))) & mask;
+    }
+
+public:
+    SetIndexer(int numSets = 1, IndexFunction function = IndexFunction::Modulo)
+        : function(function), numSets(numSets > 0 ? numSets : 1), modulus(this->numSets), bits(0) {
+        while ((2 << bits) <= this->numSets) {
+            bits++;
+        }
+        mask = (Address(1) << bits) - 1;
+        powerOfTwo = (1 << bits) == this->numSets;
+        if (function == IndexFunction::PrimeModulo) {
+            while (modulus > 1 && !isPrime(modulus)) {
+                modulus--;
+            }
+        }
+        if (bits == 0 && (function == IndexFunction::XorFold || function == IndexFunction::Skewed)) {
+            this->function = IndexFunction::Modulo; // A single set has nothing to hash
+        }
+    }
+
+    IndexFunction getFunction() const {
+        return function;
+    }
+
+    // Set for blockAddress; way only matters for the skewed function
+    int index(Address blockAddress, int way = 0) const {
+        switch (function) {
+        case IndexFunction::Modulo:
+            return (int)(powerOfTwo ? blockAddress & mask : blockAddress % numSets);
+        case IndexFunction::PrimeModulo:
+            return (int)(blockAddress % modulus);
+        case IndexFunction::XorFold:
+            return (int)fold(blockAddress);
+        case IndexFunction::Skewed:
+            return (int)((blockAddress & mask) ^ skew(blockAddress >> bits, way));
+        }
+        return 0;
+    }
+
+    Address tag(Address blockAddress) const {
+        switch (function) {
+        case IndexFunction::Modulo:
+            return powerOfTwo ? blockAddress >> bits : blockAddress / numSets;
+        case IndexFunction::PrimeModulo:
+            return blockAddress / modulus;
+        default:
+            return blockAddress >> bits;
+        }
+    }
+
+    // Inverse of index() and tag()
+    Address blockAddress(Address tag, int set, int way = 0) const {
+        switch (function) {
+        case IndexFunction::Modulo:
+            return powerOfTwo ? (tag << bits) | set : tag * numSets + set;
+        case IndexFunction::PrimeModulo:
+            return tag * modulus + set;
+        case IndexFunction::XorFold:
+            return (tag << bits) | (set ^ fold(tag));
+        case IndexFunction::Skewed:
+            return (tag << bits) | (set ^ skew(tag, way));
+        }
+        return 0;
+    }
+};
+
+// Per-set counters for the heat map
+struct SetStats {
+    long long accesses;
+    long long misses;
+    long long evictions;
+    long long conflictEvictions; // Victims a fully-associative cache of the same size would still hold
+};
+
+class Cache {
+protected:
+    std::vector<CacheBlock> cache;
+    int numBlocks;
+    int blockSize;
+    int offsetBits; // Address bits within a block
+    long long currentTime;
+    long long cacheMisses;
+    long long readMisses;
+    long long writeMisses;
+    long long cacheSearches;
+
+    // Write policy
+    WriteHitPolicy writeHitPolicy;
+    WriteMissPolicy writeMissPolicy;
+    long long writebacks; // Dirty blocks evicted to the next level
+    long long writeThroughs; // Writes forwarded to the next level (write-through or write-around)
+
+    // Sends a dirty victim to the next level
+    void writeBackBlock(Address blockAddress) {
+        writebacks++;
+        if (onWriteback) {
+            onWriteback(blockAddress << offsetBits);
+        }
+    }
+
+    // Forwards a single write to the next level
+    void writeThrough(Address memoryAddress) {
+        writeThroughs++;
+        if (onWriteThrough) {
+            onWriteThrough(memoryAddress);
+        }
+    }
+
+    // Prefetch effectiveness
+    PrefetchThrottle throttle;
+    int prefetchLatency; // Accesses to this cache before a prefetch fill would complete
+    long long issuedPrefetches;
+    long long usefulPrefetches;
+    long long latePrefetches;
+    long long uselessPrefetches;
+    long long pollutionMisses;
+    std::vector<Address> pollutionFilter; // Blocks evicted by prefetches, indexed by block address
+
+    MissClassifier classifier; // Disabled unless 3C classification is enabled
+    std::vector<SetStats> setStats; // Empty unless the set heat map is enabled
+    SetIndexer indexer; // Block address to set mapping
+
+    void recordSetAccess(int setIndex, bool hit) {
+        if (setStats.empty()) {
+            return;
+        }
+        setStats[setIndex].accesses++;
+        if (!hit) {
+            setStats[setIndex].misses++;
+        }
+    }
+
+    void recordSetEviction(int setIndex, Address victimBlock) {
+        if (setStats.empty()) {
+            return;
+        }
+        setStats[setIndex].evictions++;
+        if (classifier.isEnabled() && classifier.contains(victimBlock)) {
+            setStats[setIndex].conflictEvictions++;
+        }
+    }
+
+    void recordPrefetchHit(CacheBlock& block) {
+        bool late = currentTime - block.prefetchTime < prefetchLatency;
+        usefulPrefetches++;
+        if (late) {
+            latePrefetches++;
+        }
+        throttle.recordUseful(late);
+        block.prefetched = false;
+    }
+
+    void recordEviction(const CacheBlock& victim, Address victimBlock, bool byPrefetch) {
+        if (!victim.valid) {
+            return;
+        }
+        if (victim.prefetched) {
+            uselessPrefetches++;
+        } else if (byPrefetch) {
+            pollutionFilter[victimBlock % pollutionFilter.size()] = victimBlock;
+        }
+    }
+
+    void recordDemandMiss(Address blockAddress) {
+        Address& filterBlock = pollutionFilter[blockAddress % pollutionFilter.size()];
+        if (filterBlock == blockAddress) {
+            pollutionMisses++;
+            throttle.recordPollution();
+            filterBlock = InvalidAddress;
+        }
+        throttle.recordMiss();
+    }
+
+public:
+    std::function<void(Address)> onWriteback; // Callback receiving the address of each dirty block written back
+    std::function<void(Address)> onWriteThrough; // Callback receiving the address of each forwarded write
+
+    Cache(int numBlocks, int blockSize) : numBlocks(numBlocks), blockSize(blockSize),
+        offsetBits(blockOffsetBits(blockSize, AddressMode::Word)), currentTime(0),
+        cacheMisses(0), readMisses(0), writeMisses(0), cacheSearches(0),
+        writeHitPolicy(WriteHitPolicy::WriteBack), writeMissPolicy(WriteMissPolicy::WriteAllocate),
+        writebacks(0), writeThroughs(0), prefetchLatency(1),
+        issuedPrefetches(0), usefulPrefetches(0), latePrefetches(0), uselessPrefetches(0), pollutionMisses(0) {
+        cache.resize(numBlocks);
+        pollutionFilter.resize(numBlocks, InvalidAddress);
+        indexer = SetIndexer(numBlocks);
+    }
+
+    virtual bool access(Address memoryAddress, bool write) = 0; // Pure virtual function
+
+    virtual int getNumSets() const {
+        return numBlocks;
+    }
+
+    long long getMisses() const {
+        return cacheMisses;
+    }
+
+    long long getSearches() const {
+        return cacheSearches;
+    }
+
+    int getBlockSize() const {
+        return blockSize;
+    }
+
+    // Selects word or byte addresses; call before the first access
+    void setAddressMode(AddressMode mode) {
+        offsetBits = blockOffsetBits(blockSize, mode);
+    }
+
+    int getOffsetBits() const {
+        return offsetBits;
+    }
+
+    const std::vector<CacheBlock>& getBlocks() const {
+        return cache;
+    }
+
+    void setWritePolicy(WriteHitPolicy hitPolicy, WriteMissPolicy missPolicy) {
+        writeHitPolicy = hitPolicy;
+        writeMissPolicy = missPolicy;
+    }
+
+    WriteHitPolicy getWriteHitPolicy() const {
+        return writeHitPolicy;
+    }
+
+    WriteMissPolicy getWriteMissPolicy() const {
+        return writeMissPolicy;
+    }
+
+    long long getWritebacks() const {
+        return writebacks;
+    }
+
+    // Counts a writeback an eviction callback performed for this cache, once the dirty
+    // data has actually left for the next level
+    void countWriteback() {
+        writebacks++;
+    }
+
+    long long getWriteThroughs() const {
+        return writeThroughs;
+    }
+
+    long long getPrefetchesIssued() const {
+        return issuedPrefetches;
+    }
+
+    // Enables feedback-directed throttling of the prefetch degree
+    void setPrefetchThrottling(bool enabled, int maxDegree = 4, int interval = 256) {
+        throttle = PrefetchThrottle(throttle.getDegree(), maxDegree, interval);
+        throttle.enable(enabled);
+    }
+
+    // Sets the prefetch degree directly; 0 turns the next-line prefetcher off
+    void setPrefetchDegree(int degree) {
+        throttle = PrefetchThrottle(degree);
+    }
+
+    // Classifies misses as compulsory, capacity or conflict with a shadow
+    // fully-associative LRU cache of the same capacity
+    void enableMissClassification() {
+        classifier = MissClassifier(numBlocks);
+    }
+
+    const MissClassifier& getMissClassifier() const {
+        return classifier;
+    }
+
+    // Counts demand accesses, misses and evictions per set. Conflict evictions are
+    // only counted while miss classification is enabled.
+    void enableSetHeatMap() {
+        setStats.assign(getNumSets(), SetStats{0, 0, 0, 0});
+    }
+
+    // Selects how block addresses map to sets; call before the first access
+    void setIndexFunction(IndexFunction function) {
+        indexer = SetIndexer(getNumSets(), function);
+    }
+
+    IndexFunction getIndexFunction() const {
+        return indexer.getFunction();
+    }
+
+    const std::vector<SetStats>& getSetStats() const {
+        return setStats;
+    }
+
+    // One row per set: set,accesses,misses,evictions,conflict_evictions
+    void writeSetHeatMapCSV(std::ostream& out) const {
+        out << "set,accesses,misses,evictions,conflict_evictions\n";
+        for (size_t i = 0; i < setStats.size(); ++i) {
+            const SetStats& set = setStats[i];
+            out << i << ',' << set.accesses << ',' << set.misses << ','
+                << set.evictions << ',' << set.conflictEvictions << '\n';
+        }
+    }
+
+    // The set count (int) followed by the four counters of each set (long long), native-endian
+    void writeSetHeatMapBinary(std::ostream& out) const {
+        int count = setStats.size();
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(setStats.data()), setStats.size() * sizeof(SetStats));
+    }
+
+    void setPrefetchLatency(int accesses) {
+        prefetchLatency = accesses;
+    }
+
+    int getPrefetchDegree() const {
+        return throttle.getDegree();
+    }
+
+    int getPrefetchLimit(int requested) const {
+        return throttle.limit(requested);
+    }
+
+    // Registers every counter under prefix (e.g. "l1.misses")
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        registry.add(prefix + ".misses", &cacheMisses);
+        registry.add(prefix + ".searches", &cacheSearches);
+        registry.addRatio(prefix + ".hit_rate", [this] {
+            return cacheSearches ? 1.0 - (double)cacheMisses / cacheSearches : 0.0;
+        });
+        registry.add(prefix + ".read_misses", &readMisses);
+        registry.add(prefix + ".write_misses", &writeMisses);
+        registry.add(prefix + ".writebacks", &writebacks);
+        registry.add(prefix + ".write_throughs", &writeThroughs);
+        if (classifier.isEnabled()) {
+            classifier.registerStats(registry, prefix);
+        }
+        registry.add(prefix + ".prefetches_issued", &issuedPrefetches);
+        registry.add(prefix + ".useful_prefetches", &usefulPrefetches);
+        registry.add(prefix + ".late_prefetches", &latePrefetches);
+        registry.add(prefix + ".useless_prefetches", &uselessPrefetches);
+        registry.add(prefix + ".pollution_misses", &pollutionMisses);
+        registry.addGauge(prefix + ".prefetch_degree", [this] {
+            return throttle.getDegree();
+        });
+    }
+
+    void printStats(const std::string& cacheName) const {
+        std::cout << cacheName << " Cache Stats:" << std::endl;
+        std::cout << "Cache Misses: " << cacheMisses << std::endl;
+        std::cout << "Cache Searches: " << cacheSearches << std::endl;
+        std::cout << "Cache Hit Rate: " << (1.0 - (double)cacheMisses / cacheSearches) * 100 << "%" << std::endl;
+        std::cout << "Read Misses: " << readMisses << std::endl;
+        std::cout << "Write Misses: " << writeMisses << std::endl;
+        std::cout << "Writebacks: " << writebacks << std::endl;
+        if (writeThroughs > 0) {
+            std::cout << "Write-Throughs: " << writeThroughs << std::endl;
+        }
+        if (classifier.isEnabled()) {
+            std::cout << "Compulsory Misses: " << classifier.getCompulsoryMisses() << std::endl;
+            std::cout << "Capacity Misses: " << classifier.getCapacityMisses() << std::endl;
+            std::cout << "Conflict Misses: " << classifier.getConflictMisses() << std::endl;
+        }
+        if (!setStats.empty()) {
+            auto hottest = std::max_element(setStats.begin(), setStats.end(),
+                [](const SetStats& a, const SetStats& b) {
+                    return a.misses < b.misses;
+                });
+            std::cout << "Hottest Set: " << hottest - setStats.begin() << " (accesses: " << hottest->accesses
+                      << ", misses: " << hottest->misses << ", conflict evictions: " << hottest->conflictEvictions
+                      << ")" << std::endl;
+        }
+        if (issuedPrefetches > 0) {
+            std::cout << "Prefetches Issued: " << issuedPrefetches << std::endl;
+            std::cout << "Useful Prefetches: " << usefulPrefetches << " (late: " << latePrefetches << ")" << std::endl;
+            std::cout << "Useless Prefetches: " << uselessPrefetches << std::endl;
+            std::cout << "Prefetch Pollution Misses: " << pollutionMisses << std::endl;
+            std::cout << "Prefetch Degree: " << throttle.getDegree() << std::endl;
+        }
+    }
+};
+
+class DirectMappedCache : public Cache {
+private:
+    // Line holding memoryAddress, or -1 if the block is not resident
+    int findLine(Address memoryAddress) const {
+        Address blockAddress = memoryAddress >> offsetBits;
+        int index = indexer.index(blockAddress);
+        return cache[index].valid && cache[index].tag == indexer.tag(blockAddress) ? index : -1;
+    }
+
+public:
+    // Callback for eviction, with the victim's block address. It takes over the victim,
+    // so a dirty victim is only counted as a writeback once it calls countWriteback.
+    std::function<void(const CacheBlock&, Address)> onEvict;
+    std::function<void(Address)> onMiss; // Callback for miss (prefetcher training)
+
+    DirectMappedCache(int numBlocks, int blockSize) : Cache(numBlocks, blockSize) {}
+
+    // Marks the resident block holding memoryAddress dirty (e.g. after a victim cache swap)
+    void markDirty(Address memoryAddress) {
+        int index = findLine(memoryAddress);
+        if (index >= 0) {
+            cache[index].dirty = true;
+        }
+    }
+
+    // Clears the dirty bit once the block's data has been written to the next level
+    void markClean(Address memoryAddress) {
+        int index = findLine(memoryAddress);
+        if (index >= 0) {
+            cache[index].dirty = false;
+        }
+    }
+
+    bool contains(Address memoryAddress) const {
+        return findLine(memoryAddress) >= 0;
+    }
+
+    bool isDirty(Address memoryAddress) const {
+        int index = findLine(memoryAddress);
+        return index >= 0 && cache[index].dirty;
+    }
+
+    // Line a block maps to, whether or not it is resident
+    int lineOf(Address memoryAddress) const {
+        return indexer.index(memoryAddress >> offsetBits);
+    }
+
+    // Block address held by a valid line
+    Address getBlockAddress(int line) const {
+        return indexer.blockAddress(cache[line].tag, line);
+    }
+
+    // Removes the block without writing it back; returns true if it was present
+    bool invalidate(Address memoryAddress, bool* wasDirty = nullptr) {
+        int index = findLine(memoryAddress);
+        if (index < 0) {
+            return false;
+        }
+        if (wasDirty) {
+            *wasDirty = cache[index].dirty;
+        }
+        cache[index].valid = false;
+        cache[index].dirty = false;
+        return true;
+    }
+
+    int countValidBlocks() const {
+        int count = 0;
+        for (const auto& block : cache) {
+            count += block.valid ? 1 : 0;
+        }
+        return count;
+    }
+
+    bool access(Address memoryAddress, bool write) override {
+        currentTime++;
+        cacheSearches++;
+
+        Address blockAddress = memoryAddress >> offsetBits;
+        int index = indexer.index(blockAddress);
+        Address tag = indexer.tag(blockAddress);
+        bool hit = cache[index].valid && cache[index].tag == tag;
+        if (classifier.isEnabled()) {
+            classifier.access(blockAddress, hit);
+        }
+        recordSetAccess(index, hit);
+
+        if (hit) {
+            // Cache hit
+            cache[index].lastAccessTime = currentTime;
+            if (write) {
+                if (writeHitPolicy == WriteHitPolicy::WriteThrough) {
+                    writeThrough(memoryAddress);
+                } else {
+                    cache[index].dirty = true;
+                }
+            }
+            return true; // Hit
+        } else {
+            // Cache miss
+            cacheMisses++;
+            if (write) {
+                writeMisses++;
+            } else {
+                readMisses++;
+            }
+
+            if (onMiss) {
+                onMiss(memoryAddress);
+            }
+
+            if (write && writeMissPolicy == WriteMissPolicy::NoWriteAllocate) {
+                // Write around the cache
+                writeThrough(memoryAddress);
+                return false; // Miss
+            }
+
+            // Evict the current block (if valid, notify TwoLevelCache to add to victim cache)
+            if (cache[index].valid) {
+                Address victimBlock = getBlockAddress(index);
+                recordSetEviction(index, victimBlock);
+                if (onEvict) {
+                    // The callback owns the victim and counts its writeback, if any
+                    onEvict(cache[index], victimBlock);
+                } else if (cache[index].dirty) {
+                    writeBackBlock(victimBlock);
+                }
+            }
+
+            // Replace the block
+            cache[index].valid = true;
+            cache[index].tag = tag;
+            cache[index].lastAccessTime = currentTime;
+            cache[index].dirty = false;
+            if (write) {
+                if (writeHitPolicy == WriteHitPolicy::WriteThrough) {
+                    writeThrough(memoryAddress);
+                } else {
+                    cache[index].dirty = true;
+                }
+            }
+            return false; // Miss
+        }
+    }
+};
+
+class SetAssociativeCache : public Cache {
+private:
+    int ways;
+    std::vector<std::vector<CacheBlock>> sets;
+    std::vector<Address> tags; // Tag of every way, set by set; InvalidAddress for invalid ways (unused when skewed)
+    std::unordered_map<Address, int> accessFrequency; // Tracks access frequency for prefetching
+
+    bool skewed() const {
+        return indexer.getFunction() == IndexFunction::Skewed;
+    }
+
+    int findLRU(int setIndex) const {
+        int lruIndex = 0;
+        long long minTime = LLONG_MAX;
+        for (int i = 0; i < ways; ++i) {
+            if (!sets[setIndex][i].valid) {
+                return i; // Fill an empty way first
+            }
+            if (sets[setIndex][i].lastAccessTime < minTime) {
+                lruIndex = i;
+                minTime = sets[setIndex][i].lastAccessTime;
+            }
+        }
+        return lruIndex;
+    }
+
+    // Returns the way holding blockAddress (-1 if absent) and sets setIndex to its set.
+    // On a miss setIndex is the way-0 set.
+    int findWay(Address blockAddress, int& setIndex) const {
+        Address tag = indexer.tag(blockAddress);
+        if (!skewed()) {
+            setIndex = indexer.index(blockAddress);
+            const Address* setTags = &tags[(size_t)setIndex * ways];
+            for (int way = 0; way < ways; ++way) {
+                if (setTags[way] == tag) {
+                    return way;
+                }
+            }
+            return -1;
+        }
+        for (int way = 0; way < ways; ++way) {
+            int set = indexer.index(blockAddress, way);
+            if (sets[set][way].valid && sets[set][way].tag == tag) {
+                setIndex = set;
+                return way;
+            }
+        }
+        setIndex = indexer.index(blockAddress);
+        return -1;
+    }
+
+    // Picks the way to replace for blockAddress and sets setIndex to its set. A skewed
+    // cache chooses among each way's candidate block.
+    int findVictim(Address blockAddress, int& setIndex) const {
+        if (!skewed()) {
+            setIndex = indexer.index(blockAddress);
+            return findLRU(setIndex);
+        }
+        int victim = 0;
+        long long minTime = LLONG_MAX;
+        for (int way = 0; way < ways; ++way) {
+            int set = indexer.index(blockAddress, way);
+            if (!sets[set][way].valid) {
+                setIndex = set;
+                return way; // Fill an empty way first
+            }
+            if (sets[set][way].lastAccessTime < minTime) {
+                victim = way;
+                minTime = sets[set][way].lastAccessTime;
+                setIndex = set;
+            }
+        }
+        return victim;
+    }
+
+    void evict(int setIndex, int blockIndex, bool byPrefetch) {
+        CacheBlock& victim = sets[setIndex][blockIndex];
+        if (!victim.valid) {
+            return;
+        }
+        Address victimBlock = indexer.blockAddress(victim.tag, setIndex, blockIndex);
+        recordEviction(victim, victimBlock, byPrefetch);
+        recordSetEviction(setIndex, victimBlock);
+        if (onEvict) {
+            onEvict(victim, victimBlock);
+        }
+        if (victim.dirty) {
+            // Write back to memory if dirty
+            writeBackBlock(victimBlock);
+        }
+        if (!skewed()) {
+            tags[(size_t)setIndex * ways + blockIndex] = InvalidAddress;
+        }
+        victim.valid = false;
+    }
+
+    // Installs blockAddress in the given way after its previous block has been evicted
+    CacheBlock& install(int setIndex, int way, Address blockAddress) {
+        CacheBlock& block = sets[setIndex][way];
+        block.valid = true;
+        block.tag = indexer.tag(blockAddress);
+        block.lastAccessTime = currentTime;
+        block.dirty = false;
+        block.prefetched = false;
+        if (!skewed()) {
+            tags[(size_t)setIndex * ways + way] = block.tag;
+        }
+        return block;
+    }
+
+public:
+    std::function<void(Address)> onMiss; // Callback for miss (prefetcher training)
+    std::function<void(const CacheBlock&, Address)> onEvict; // Callback for eviction (inclusion enforcement)
+    std::function<bool(Address)> heldAbove; // True for blocks the level above holds; prefetches skip them
+    bool allocateOnMiss; // False when the level above holds demand fills exclusively
+
+    SetAssociativeCache(int numBlocks, int blockSize, int ways) : Cache(numBlocks, blockSize), ways(ways), allocateOnMiss(true) {
+        int numSets = numBlocks / ways;
+        sets.resize(numSets, std::vector<CacheBlock>(ways));
+        tags.resize((size_t)numSets * ways, InvalidAddress);
+        indexer = SetIndexer(numSets);
+    }
+
+    bool access(Address memoryAddress, bool write) override {
+        currentTime++;
+        cacheSearches++;
+
+        Address blockAddress = memoryAddress >> offsetBits;
+        int setIndex;
+        int way = findWay(blockAddress, setIndex);
+        if (classifier.isEnabled()) {
+            classifier.access(blockAddress, way >= 0);
+        }
+        recordSetAccess(setIndex, way >= 0);
+        if (way >= 0) {
+            // Cache hit
+            CacheBlock& block = sets[setIndex][way];
+            block.lastAccessTime = currentTime;
+            if (block.prefetched) {
+                recordPrefetchHit(block);
+            }
+            if (write) {
+                if (writeHitPolicy == WriteHitPolicy::WriteThrough) {
+                    writeThrough(memoryAddress);
+                } else {
+                    block.dirty = true;
+                }
+            }
+            return true; // Hit
+        } else {
+            // Cache miss
+            cacheMisses++;
+            if (write) {
+                writeMisses++;
+            } else {
+                readMisses++;
+            }
+            recordDemandMiss(blockAddress);
+
+            // Prefetch the next blocks
+            if (throttle.getDegree() > 0) {
+                SIM_PROFILE_SCOPE(Prefetch);
+                for (int i = 1; i <= throttle.getDegree(); ++i) {
+                    prefetch(memoryAddress + ((Address)i << offsetBits));
+                }
+            }
+
+            if (onMiss) {
+                onMiss(memoryAddress);
+            }
+
+            if (write && writeMissPolicy == WriteMissPolicy::NoWriteAllocate) {
+                // Write around the cache
+                writeThrough(memoryAddress);
+                return false; // Miss
+            }
+            if (!allocateOnMiss) {
+                return false; // Miss
+            }
+
+            int lruIndex = findVictim(blockAddress, setIndex);
+
+            // Replace the LRU block
+            evict(setIndex, lruIndex, false);
+            CacheBlock& block = install(setIndex, lruIndex, blockAddress);
+            if (write) {
+                if (writeHitPolicy == WriteHitPolicy::WriteThrough) {
+                    writeThrough(memoryAddress);
+                } else {
+                    block.dirty = true;
+                }
+            }
+            return false; // Miss
+        }
+    }
+
+    int getNumSets() const override {
+        return sets.size();
+    }
+
+    bool contains(Address memoryAddress) const {
+        int setIndex;
+        return findWay(memoryAddress >> offsetBits, setIndex) >= 0;
+    }
+
+    // Removes the block without writing it back; returns true if it was present
+    bool invalidate(Address memoryAddress, bool* wasDirty = nullptr) {
+        int setIndex;
+        int way = findWay(memoryAddress >> offsetBits, setIndex);
+        if (way < 0) {
+            return false;
+        }
+        CacheBlock& block = sets[setIndex][way];
+        if (wasDirty) {
+            *wasDirty = block.dirty;
+        }
+        if (block.prefetched) {
+            recordPrefetchHit(block); // Demanded by the level above
+        }
+        block.valid = false;
+        block.dirty = false;
+        if (!skewed()) {
+            tags[(size_t)setIndex * ways + way] = InvalidAddress;
+        }
+        return true;
+    }
+
+    // Installs a block supplied by the level above (clean victims, inclusion fills).
+    // Not counted as a demand access.
+    void fill(Address memoryAddress, bool dirty) {
+        Address blockAddress = memoryAddress >> offsetBits;
+        int setIndex;
+        int way = findWay(blockAddress, setIndex);
+        if (way >= 0) {
+            sets[setIndex][way].lastAccessTime = currentTime;
+            sets[setIndex][way].dirty |= dirty;
+            return;
+        }
+
+        int lruIndex = findVictim(blockAddress, setIndex);
+        evict(setIndex, lruIndex, false);
+        install(setIndex, lruIndex, blockAddress).dirty = dirty;
+    }
+
+    int countValidBlocks() const {
+        int count = 0;
+        for (const auto& set : sets) {
+            for (const auto& block : set) {
+                count += block.valid ? 1 : 0;
+            }
+        }
+        return count;
+    }
+
+    // Accepts a dirty block written back from the level above. Not counted as a demand access.
+    void writeback(Address memoryAddress) {
+        Address blockAddress = memoryAddress >> offsetBits;
+        int setIndex;
+        int way = findWay(blockAddress, setIndex);
+        if (writeHitPolicy == WriteHitPolicy::WriteThrough ||
+            (way < 0 && writeMissPolicy == WriteMissPolicy::NoWriteAllocate)) {
+            // Pass the block on to the next level
+            writeBackBlock(blockAddress);
+            return;
+        }
+        if (way >= 0) {
+            sets[setIndex][way].dirty = true;
+            return;
+        }
+        fill(memoryAddress, true);
+    }
+
+    void prefetch(Address memoryAddress) {
+        if (heldAbove && heldAbove(memoryAddress)) {
+            return; // A copy here would duplicate the level above's
+        }
+        Address blockAddress = memoryAddress >> offsetBits;
+        int setIndex;
+
+        if (findWay(blockAddress, setIndex) < 0) {
+            // Prefetch the block into the cache
+            int lruIndex = findVictim(blockAddress, setIndex);
+            issuedPrefetches++;
+            throttle.recordIssued();
+
+            // Replace the LRU block
+            evict(setIndex, lruIndex, true);
+            CacheBlock& block = install(setIndex, lruIndex, blockAddress);
+            block.prefetched = true;
+            block.prefetchTime = currentTime;
+        }
+    }
+};
+
+// Fully-associative LRU cache. Blocks live in the base class array, one per LRU list
+// slot, so lookups, hits and replacements are O(1) at any capacity. With no index
+// bits, a block's tag is its whole block address.
+class FullyAssociativeCache : public Cache {
+private:
+    LRUList lru;
+
+    void evictLRU() {
+        int slot = lru.lru();
+        CacheBlock& victim = cache[slot];
+        recordEviction(victim, victim.tag, false);
+        recordSetEviction(0, victim.tag);
+        if (onEvict) {
+            onEvict(victim, victim.tag);
+        }
+        if (victim.dirty) {
+            writeBackBlock(victim.tag);
+        }
+        victim.valid = false;
+        victim.dirty = false;
+    }
+
+    // Installs tag in a free slot, evicting the LRU block when full
+    CacheBlock& allocate(Address tag) {
+        if (lru.size() == lru.capacity()) {
+            evictLRU();
+        }
+        int slot = lru.insert(tag);
+        CacheBlock& block = cache[slot];
+        block.valid = true;
+        block.dirty = false;
+        block.prefetched = false;
+        block.tag = tag;
+        block.lastAccessTime = currentTime;
+        return block;
+    }
+
+public:
+    std::function<void(Address)> onMiss; // Callback for miss (prefetcher training)
+    std::function<void(const CacheBlock&, Address)> onEvict; // Callback for eviction, with the victim's block address
+
+    FullyAssociativeCache(int numBlocks, int blockSize) : Cache(numBlocks, blockSize), lru(numBlocks) {}
+
+    bool access(Address memoryAddress, bool write) override {
+        currentTime++;
+        cacheSearches++;
+
+        Address tag = memoryAddress >> offsetBits;
+        int slot = lru.find(tag);
+        if (classifier.isEnabled()) {
+            classifier.access(tag, slot >= 0);
+        }
+        recordSetAccess(0, slot >= 0);
+
+        if (slot >= 0) {
+            // Cache hit
+            lru.touch(slot);
+            cache[slot].lastAccessTime = currentTime;
+            if (write) {
+                if (writeHitPolicy == WriteHitPolicy::WriteThrough) {
+                    writeThrough(memoryAddress);
+                } else {
+                    cache[slot].dirty = true;
+                }
+            }
+            return true; // Hit
+        }
+
+        // Cache miss
+        cacheMisses++;
+        if (write) {
+            writeMisses++;
+        } else {
+            readMisses++;
+        }
+        recordDemandMiss(tag);
+        if (onMiss) {
+            onMiss(memoryAddress);
+        }
+        if (write && writeMissPolicy == WriteMissPolicy::NoWriteAllocate) {
+            // Write around the cache
+            writeThrough(memoryAddress);
+            return false; // Miss
+        }
+
+        CacheBlock& block = allocate(tag);
+        if (write) {
+            if (writeHitPolicy == WriteHitPolicy::WriteThrough) {
+                writeThrough(memoryAddress);
+            } else {
+                block.dirty = true;
+            }
+        }
+        return false; // Miss
+    }
+
+    int getNumSets() const override {
+        return 1;
+    }
+
+    bool contains(Address memoryAddress) const {
+        return lru.find(memoryAddress >> offsetBits) >= 0;
+    }
+
+    // Removes the block without writing it back; returns true if it was present
+    bool invalidate(Address memoryAddress, bool* wasDirty = nullptr) {
+        int slot = lru.erase(memoryAddress >> offsetBits);
+        if (slot < 0) {
+            return false;
+        }
+        if (wasDirty) {
+            *wasDirty = cache[slot].dirty;
+        }
+        // Follow the LRU list, which moved its last slot into the freed one
+        int last = lru.size();
+        if (slot != last) {
+            cache[slot] = cache[last];
+        }
+        cache[last].valid = false;
+        cache[last].dirty = false;
+        return true;
+    }
+
+    // Installs a block supplied by the level above. Not counted as a demand access.
+    void fill(Address memoryAddress, bool dirty) {
+        Address tag = memoryAddress >> offsetBits;
+        int slot = lru.find(tag);
+        if (slot >= 0) {
+            lru.touch(slot);
+            cache[slot].lastAccessTime = currentTime;
+            cache[slot].dirty |= dirty;
+            return;
+        }
+        allocate(tag).dirty = dirty;
+    }
+
+    // Accepts a dirty block written back from the level above. Not counted as a demand access.
+    void writeback(Address memoryAddress) {
+        Address tag = memoryAddress >> offsetBits;
+        bool present = lru.find(tag) >= 0;
+        if (writeHitPolicy == WriteHitPolicy::WriteThrough ||
+            (!present && writeMissPolicy == WriteMissPolicy::NoWriteAllocate)) {
+            // Pass the block on to the next level
+            writeBackBlock(tag);
+            return;
+        }
+        fill(memoryAddress, true);
+    }
+
+    int countValidBlocks() const {
+        return lru.size();
+    }
+};
+
+enum class GHBMode {
+    GlobalDelta, // G/DC: one global miss stream
+    PCDelta      // PC/DC: miss stream localized per instruction address
+};
+
+enum class PrefetchLevel {
+    None,
+    L1, // Train on L1 misses, fill the prefetch cache
+    L2  // Train on L2 misses, fill the L2 cache
+};
+
+// Global History Buffer prefetcher (Nesbit & Smith). Miss addresses are kept in a
+// circular history; entries with the same index key are chained through links, so
+// an update is O(1) and a prediction walks at most maxChainLength entries.
+class GHBPrefetcher {
+private:
+    struct HistoryEntry {
+        Address blockAddress;
+        long long link; // Sequence number of the previous entry with the same key, -1 if none
+    };
+
+    struct IndexEntry {
+        int key;
+        long long head; // Sequence number of the newest entry with this key, -1 if none
+    };
+
+    static const int maxChainLength = 16;
+
+    GHBMode mode;
+    int degree;
+    std::vector<HistoryEntry> history; // Circular buffer
+    std::vector<IndexEntry> indexTable; // Direct-mapped, power-of-two size
+    long long nextSequence; // Sequence number of the next history insert
+    long long trainedMisses;
+    long long issuedPrefetches;
+
+    bool inHistory(long long sequence) const {
+        return sequence >= 0 && sequence >= nextSequence - (long long)history.size();
+    }
+
+    int indexSlot(int key) const {
+        unsigned int hash = (unsigned int)key * 2654435761u;
+        return (int)(hash >> 16) & ((int)indexTable.size() - 1);
+    }
+
+public:
+    GHBPrefetcher(GHBMode mode = GHBMode::GlobalDelta, int historySize = 256, int indexSize = 256, int degree = 4)
+        : mode(mode), degree(degree), nextSequence(0), trainedMisses(0), issuedPrefetches(0) {
+        int tableSize = 1;
+        while (tableSize < indexSize) {
+            tableSize <<= 1;
+        }
+        history.resize(historySize, HistoryEntry{0, -1});
+        indexTable.resize(tableSize, IndexEntry{0, -1});
+    }
+
+    // Records a miss and appends predicted block addresses to prefetches
+    void onMiss(Address blockAddress, int pc, std::vector<Address>& prefetches) {
+        trainedMisses++;
+        int key = (mode == GHBMode::PCDelta) ? pc : 0;
+        IndexEntry& slot = indexTable[indexSlot(key)];
+        long long previous = (slot.key == key && inHistory(slot.head)) ? slot.head : -1;
+
+        long long sequence = nextSequence++;
+        history[sequence % history.size()] = HistoryEntry{blockAddress, previous};
+        slot.key = key;
+        slot.head = sequence;
+
+        // Walk the chain newest to oldest
+        Address chain[maxChainLength];
+        int length = 0;
+        for (long long s = sequence; length < maxChainLength && inHistory(s);) {
+            const HistoryEntry& entry = history[s % history.size()];
+            chain[length++] = entry.blockAddress;
+            s = entry.link;
+        }
+        if (length < 4) {
+            return;
+        }
+
+        // deltas[i] = chain[i] - chain[i + 1], newest first
+        long long deltas[maxChainLength - 1];
+        for (int i = 0; i + 1 < length; ++i) {
+            deltas[i] = (long long)(chain[i] - chain[i + 1]);
+        }
+        int numDeltas = length - 1;
+
+        // Find the most recent earlier occurrence of the latest delta pair
+        for (int k = 1; k + 1 < numDeltas; ++k) {
+            if (deltas[k] != deltas[0] || deltas[k + 1] != deltas[1]) {
+                continue;
+            }
+            // Replay the deltas that followed that occurrence, repeating the pattern
+            // (period k) until degree prefetches are issued
+            long long address = (long long)blockAddress;
+            for (int i = 0; i < degree; ++i) {
+                address += deltas[(k - 1) - (i % k)];
+                if (address >= 0 && (Address)address != blockAddress) {
+                    prefetches.push_back((Address)address);
+                    issuedPrefetches++;
+                }
+            }
+            return;
+        }
+    }
+
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        registry.add(prefix + ".trained_misses", &trainedMisses);
+        registry.add(prefix + ".issued_prefetches", &issuedPrefetches);
+    }
+
+    long long getTrainedMisses() const {
+        return trainedMisses;
+    }
+
+    long long getIssuedPrefetches() const {
+        return issuedPrefetches;
+    }
+};
+
+// Fixed-capacity FIFO of blocks with a tag index, modelling a small fully-associative
+// CAM (victim cache, write buffer, stream buffer). Only block metadata is moved;
+// the data words are not modelled by the simulator.
+class BlockBuffer {
+private:
+    std::vector<CacheBlock> slots; // Ring storage, oldest entry at head
+    TagIndex index; // Tag -> ring position
+    int head;
+    int count;
+
+    static void copyBlock(CacheBlock& dst, const CacheBlock& src) {
+        dst.valid = src.valid;
+        dst.dirty = src.dirty;
+        dst.prefetched = src.prefetched;
+        dst.tag = src.tag;
+        dst.lastAccessTime = src.lastAccessTime;
+        dst.prefetchTime = src.prefetchTime;
+    }
+
+    int slotAt(int position) const {
+        int slot = head + position;
+        return slot >= (int)slots.size() ? slot - (int)slots.size() : slot;
+    }
+
+public:
+    explicit BlockBuffer(int capacity) : slots(capacity), index(capacity), head(0), count(0) {}
+
+    int size() const {
+        return count;
+    }
+
+    int capacity() const {
+        return (int)slots.size();
+    }
+
+    bool full() const {
+        return count == (int)slots.size();
+    }
+
+    CacheBlock* find(Address tag) {
+        int slot = index.find(tag);
+        return slot < 0 ? nullptr : &slots[slot];
+    }
+
+    bool contains(Address tag) const {
+        return index.find(tag) >= 0;
+    }
+
+    CacheBlock& front() {
+        return slots[head];
+    }
+
+    // Appends a block; when full the oldest entry is evicted into evicted (if given)
+    bool push(const CacheBlock& block, CacheBlock* evicted = nullptr) {
+        bool didEvict = false;
+        if (full()) {
+            didEvict = true;
+            if (evicted) {
+                copyBlock(*evicted, slots[head]);
+            }
+            pop();
+        }
+        int slot = slotAt(count);
+        copyBlock(slots[slot], block);
+        index.insert(block.tag, slot);
+        count++;
+        return didEvict;
+    }
+
+    void pop() {
+        index.erase(slots[head].tag);
+        slots[head].valid = false;
+        head = slotAt(1);
+        count--;
+    }
+
+    // Removes the block with the given tag, keeping the remaining entries in FIFO order
+    bool remove(Address tag, CacheBlock* removed = nullptr) {
+        int slot = index.find(tag);
+        if (slot < 0) {
+            return false;
+        }
+        if (removed) {
+            copyBlock(*removed, slots[slot]);
+        }
+        index.erase(tag);
+        int position = slot - head;
+        if (position < 0) {
+            position += (int)slots.size();
+        }
+        for (int p = position; p + 1 < count; ++p) {
+            int to = slotAt(p);
+            int from = slotAt(p + 1);
+            copyBlock(slots[to], slots[from]);
+            index.insert(slots[to].tag, to);
+        }
+        slots[slotAt(count - 1)].valid = false;
+        count--;
+        return true;
+    }
+};
+
+// Write buffer between L1 and L2. Writes to a block already buffered are coalesced,
+// one entry drains to the next level every drainInterval cycles, reads that find
+// their block here are forwarded, and a write arriving while the buffer is full
+// stalls the processor until the next drain slot frees an entry.
+// A drainInterval of 0 drains lazily: entries leave only to make room, without stalling.
+class WriteBuffer {
+private:
+    BlockBuffer entries;
+    CacheBlock scratch;
+    int drainInterval;
+    long long nextDrainTime;
+    long long writes;
+    long long coalescedWrites;
+    long long forwardedReads;
+    long long drainedEntries;
+    long long fullEvents;
+    long long stallCycles;
+
+    void drainOldest() {
+        Address blockAddress = entries.front().tag;
+        entries.pop();
+        drainedEntries++;
+        if (onDrain) {
+            onDrain(blockAddress);
+        }
+    }
+
+public:
+    std::function<void(Address)> onDrain; // Callback receiving each drained block address
+
+    WriteBuffer(int capacity, int drainInterval = 0)
+        : entries(capacity), drainInterval(drainInterval), nextDrainTime(0),
+          writes(0), coalescedWrites(0), forwardedReads(0), drainedEntries(0), fullEvents(0), stallCycles(0) {}
+
+    bool contains(Address blockAddress) {
+        return entries.find(blockAddress) != nullptr;
+    }
+
+    // Drains every entry whose drain slot has passed by cycle now
+    void advance(long long now) {
+        if (drainInterval <= 0) {
+            return;
+        }
+        while (entries.size() > 0 && nextDrainTime <= now) {
+            drainOldest();
+            nextDrainTime += drainInterval;
+        }
+    }
+
+    // Buffers a write to blockAddress at cycle now; returns the cycles the processor stalls
+    long long write(Address blockAddress, long long now) {
+        writes++;
+        advance(now);
+
+        CacheBlock* entry = entries.find(blockAddress);
+        if (entry) {
+            coalescedWrites++;
+            entry->dirty = true;
+            return 0;
+        }
+
+        long long stall = 0;
+        if (entries.full()) {
+            fullEvents++;
+            if (drainInterval > 0) {
+                stall = nextDrainTime - now;
+                nextDrainTime += drainInterval;
+            }
+            drainOldest();
+        }
+        if (entries.size() == 0 && drainInterval > 0) {
+            nextDrainTime = now + stall + drainInterval;
+        }
+        stallCycles += stall;
+
+        scratch.valid = true;
+        scratch.dirty = true;
+        scratch.tag = blockAddress;
+        entries.push(scratch);
+        return stall;
+    }
+
+    // Read-after-write forwarding: returns true when the read is served from the buffer
+    bool forward(Address blockAddress) {
+        if (!entries.find(blockAddress)) {
+            return false;
+        }
+        forwardedReads++;
+        return true;
+    }
+
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        registry.add(prefix + ".writes", &writes);
+        registry.add(prefix + ".coalesced_writes", &coalescedWrites);
+        registry.add(prefix + ".forwarded_reads", &forwardedReads);
+        registry.add(prefix + ".drained_entries", &drainedEntries);
+        registry.add(prefix + ".full_events", &fullEvents);
+        registry.add(prefix + ".stall_cycles", &stallCycles);
+    }
+
+    void printStats() const {
+        std::cout << "Write Buffer Stats:" << std::endl;
+        std::cout << "Buffered Writes: " << writes << " (coalesced: " << coalescedWrites << ")" << std::endl;
+        std::cout << "Forwarded Reads: " << forwardedReads << std::endl;
+        std::cout << "Drained Entries: " << drainedEntries << std::endl;
+        std::cout << "Buffer Full Events: " << fullEvents << std::endl;
+        std::cout << "Write Stall Cycles: " << stallCycles << std::endl;
+    }
+};
+
+// Miss status holding registers for one cache level. Each entry tracks an outstanding
+// block fill until its fill event releases it; a later miss to the same block merges
+// into the entry instead of issuing a new request, and a primary miss that finds every
+// entry busy waits for a fill to complete. Accesses waiting on an entry are charged
+// their latency when the fill arrives.
+class MSHRFile {
+private:
+    struct Entry {
+        Address blockAddress;
+        long long start;
+        int waiters; // Accesses that complete when the fill arrives
+        long long issueCycles; // Sum of their issue cycles
+    };
+
+    std::vector<Entry> entries; // Outstanding misses, at most capacity
+    int capacity;
+    long long primaryMisses;
+    long long secondaryMisses; // Merged into an outstanding entry
+    long long fullEvents;
+    long long stallCycles;
+    long long missCycles; // Sum of primary miss latencies
+    long long busyCycles; // Cycles with at least one miss outstanding
+    long long lastChange; // Cycle of the last allocation or release
+
+    // Allocations and releases arrive in cycle order, so busy time accumulates
+    // between consecutive changes while the file is not empty
+    void advance(long long cycle) {
+        if (cycle > lastChange) {
+            if (!entries.empty()) {
+                busyCycles += cycle - lastChange;
+            }
+            lastChange = cycle;
+        }
+    }
+
+    Entry* findEntry(Address blockAddress) {
+        for (auto& entry : entries) {
+            if (entry.blockAddress == blockAddress) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    MSHRFile(int capacity = 8)
+        : capacity(capacity), primaryMisses(0), secondaryMisses(0), fullEvents(0), stallCycles(0),
+          missCycles(0), busyCycles(0), lastChange(0) {
+        entries.reserve(capacity);
+    }
+
+    bool full() const {
+        return (int)entries.size() >= capacity;
+    }
+
+    bool contains(Address blockAddress) const {
+        for (const auto& entry : entries) {
+            if (entry.blockAddress == blockAddress) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Allocates an entry for a primary miss starting at cycle start; the caller must
+    // first wait until the file is not full. The fill time is not known yet: it is
+    // reported to release() when the data arrives.
+    void allocate(Address blockAddress, long long start) {
+        advance(start);
+        entries.push_back(Entry{blockAddress, start, 0, 0});
+        primaryMisses++;
+    }
+
+    // Attaches an access issued at issueCycle to the outstanding miss for blockAddress;
+    // returns false if there is none
+    bool addWaiter(Address blockAddress, long long issueCycle) {
+        Entry* entry = findEntry(blockAddress);
+        if (!entry) {
+            return false;
+        }
+        entry->waiters++;
+        entry->issueCycles += issueCycle;
+        return true;
+    }
+
+    // Frees the entry for blockAddress when its fill arrives at cycle. Returns the
+    // number of waiting accesses (-1 if there was no entry) and adds their total
+    // latency to *waitCycles.
+    int release(Address blockAddress, long long cycle, long long* waitCycles = nullptr) {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].blockAddress == blockAddress) {
+                const Entry& entry = entries[i];
+                int waiters = entry.waiters;
+                if (waitCycles) {
+                    *waitCycles += waiters * cycle - entry.issueCycles;
+                }
+                advance(cycle);
+                missCycles += cycle - entry.start;
+                entries[i] = entries.back();
+                entries.pop_back();
+                return waiters;
+            }
+        }
+        return -1;
+    }
+
+    void recordMerge() {
+        secondaryMisses++;
+    }
+
+    void recordStall(long long cycles) {
+        fullEvents++;
+        stallCycles += cycles;
+    }
+
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        registry.add(prefix + ".primary_misses", &primaryMisses);
+        registry.add(prefix + ".merged_misses", &secondaryMisses);
+        registry.add(prefix + ".full_events", &fullEvents);
+        registry.add(prefix + ".stall_cycles", &stallCycles);
+        registry.addRatio(prefix + ".mlp", [this] {
+            return busyCycles ? (double)missCycles / busyCycles : 0.0;
+        });
+    }
+
+    void printStats(const std::string& name) const {
+        std::cout << name << " MSHR Stats:" << std::endl;
+        std::cout << "Primary Misses: " << primaryMisses << std::endl;
+        std::cout << "Merged Misses: " << secondaryMisses << std::endl;
+        std::cout << "MSHR Full Events: " << fullEvents << " (stall cycles: " << stallCycles << ")" << std::endl;
+        std::cout << "Memory-Level Parallelism: " << (busyCycles ? (double)missCycles / busyCycles : 0.0) << std::endl;
+    }
+};
+
+enum class EventType {
+    L1Fill,       // Outstanding L1 miss completes, freeing its MSHR
+    L2Fill,       // Memory read returns a block to L2
+    Writeback,    // Drained write buffer entry arrives at L2
+    PrefetchFill, // Prefetched block arrives in the prefetch cache
+    DramSchedule  // DRAM controller may issue queued requests
+};
+
+struct Event {
+    long long cycle;
+    EventType type;
+    Address blockAddress;
+    Event* next; // Bucket or free list link
+};
+
+// Discrete-event scheduler built as a bucketed timing wheel: one bucket per cycle
+// over a power-of-two horizon, with later events parked in an overflow list and
+// moved into the wheel each time it wraps. Events are pooled, so scheduling and
+// firing are O(1) and allocation-free once the pool has warmed up.
+class EventQueue {
+private:
+    std::vector<Event*> heads; // Per-bucket FIFO lists
+    std::vector<Event*> tails;
+    long long mask;
+    long long now; // Every event before this cycle has fired
+    Event* overflow; // Events at or beyond now + horizon
+    Event* freeList;
+    std::vector<std::unique_ptr<Event[]>> chunks;
+    long long pending;
+    long long inWheel; // Pending events held in buckets rather than overflow
+    long long fired;
+
+    Event* allocateEvent() {
+        if (!freeList) {
+            const int chunkSize = 1024;
+            chunks.emplace_back(new Event[chunkSize]);
+            Event* chunk = chunks.back().get();
+            for (int i = 0; i < chunkSize; ++i) {
+                chunk[i].next = freeList;
+                freeList = &chunk[i];
+            }
+        }
+        Event* event = freeList;
+        freeList = event->next;
+        return event;
+    }
+
+    void enqueue(Event* event) {
+        event->next = nullptr;
+        if (event->cycle - now > mask) {
+            event->next = overflow;
+            overflow = event;
+            return;
+        }
+        long long bucket = event->cycle & mask;
+        inWheel++;
+        if (tails[bucket]) {
+            tails[bucket]->next = event;
+        } else {
+            heads[bucket] = event;
+        }
+        tails[bucket] = event;
+    }
+
+    // Moves overflow events that now fall inside the horizon into the wheel
+    void refillFromOverflow() {
+        Event* list = overflow;
+        overflow = nullptr;
+        while (list) {
+            Event* event = list;
+            list = list->next;
+            enqueue(event);
+        }
+    }
+
+public:
+    EventQueue(int horizon = 1024) : now(0), overflow(nullptr), freeList(nullptr), pending(0), inWheel(0), fired(0) {
+        long long size = 1;
+        while (size < horizon) {
+            size <<= 1;
+        }
+        heads.resize(size, nullptr);
+        tails.resize(size, nullptr);
+        mask = size - 1;
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    // Schedules an event; cycles in the past fire at the current cycle
+    void schedule(long long cycle, EventType type, Address blockAddress) {
+        Event* event = allocateEvent();
+        event->cycle = cycle < now ? now : cycle;
+        event->type = type;
+        event->blockAddress = blockAddress;
+        enqueue(event);
+        pending++;
+    }
+
+    // Fires, in cycle order, every event scheduled at or before cycle. Events the
+    // handler schedules within that window fire in the same call.
+    template <typename Handler>
+    void runUntil(long long cycle, Handler&& handler) {
+        while (now <= cycle) {
+            if (pending == 0) {
+                now = cycle + 1;
+                return;
+            }
+            if (inWheel == 0) {
+                // Only far-future events remain: skip to the next wrap (or the target)
+                long long wrap = (now | mask) + 1;
+                if (wrap > cycle + 1) {
+                    now = cycle + 1;
+                    return;
+                }
+                now = wrap;
+                refillFromOverflow();
+                continue;
+            }
+            long long bucket = now & mask;
+            while (heads[bucket]) {
+                Event* event = heads[bucket];
+                heads[bucket] = event->next;
+                if (!heads[bucket]) {
+                    tails[bucket] = nullptr;
+                }
+                pending--;
+                inWheel--;
+                fired++;
+                handler(*event);
+                event->next = freeList;
+                freeList = event;
+            }
+            now++;
+            if ((now & mask) == 0 && overflow) {
+                refillFromOverflow();
+            }
+        }
+    }
+
+    long long getPending() const {
+        return pending;
+    }
+
+    long long getFired() const {
+        return fired;
+    }
+};
+
+enum class PagePolicy {
+    Open,  // Rows stay open after an access, so later accesses to the row hit
+    Closed // Rows are precharged after every access
+};
+
+// DRAM organization and timings. Timing parameters are in DRAM clock cycles;
+// cpuCyclesPerDramCycle converts them to processor cycles.
+struct DramConfig {
+    int channels = 1;
+    int ranks = 1;
+    int banks = 8; // Per rank
+    int rowBytes = 2048; // Row buffer size per bank
+    int tCAS = 11; // Column access to first data
+    int tRCD = 11; // Row activate to column access
+    int tRP = 11; // Precharge before the next activate
+    int tBurst = 4; // Data bus cycles per block transfer
+    int cpuCyclesPerDramCycle = 4;
+    PagePolicy pagePolicy = PagePolicy::Open;
+};
+
+// Main memory controller with per-bank row buffers. Block addresses are mapped
+// row:rank:bank:channel:column, so consecutive blocks share a row and consecutive
+// rows spread over channels and banks. Queued requests are issued FR-FCFS: the
+// oldest request that hits an open row goes first, otherwise the oldest request
+// whose bank is free.
+class DramController {
+private:
+    struct Request {
+        Address blockAddress;
+        bool write;
+        long long arrival;
+        int channel;
+        int bank; // Index over every bank of every rank and channel
+        long long row;
+    };
+
+    struct Bank {
+        long long openRow; // -1 when precharged
+        long long readyCycle; // Next cycle the bank accepts a command
+    };
+
+    DramConfig config;
+    int blocksPerRow;
+    std::vector<Bank> banks;
+    std::vector<long long> busFreeCycle; // Per channel data bus
+    std::vector<Request> queue; // In arrival order
+    long long reads;
+    long long writes;
+    long long rowHits;
+    long long rowMisses; // Bank was precharged
+    long long rowConflicts; // Another row was open
+    long long readLatency; // Sum of read arrival-to-data latencies
+    int peakQueue;
+
+    Request decode(Address blockAddress, bool write, long long arrival) const {
+        Request request;
+        request.blockAddress = blockAddress;
+        request.write = write;
+        request.arrival = arrival;
+        Address rest = blockAddress / blocksPerRow;
+        request.channel = (int)(rest % config.channels);
+        rest /= config.channels;
+        int bank = (int)(rest % config.banks);
+        rest /= config.banks;
+        int rank = (int)(rest % config.ranks);
+        request.row = (long long)(rest / config.ranks);
+        request.bank = (request.channel * config.ranks + rank) * config.banks + bank;
+        return request;
+    }
+
+    // Issues a request to its bank no earlier than cycle and returns the cycle its
+    // data transfer completes
+    long long service(const Request& request, long long cycle) {
+        Bank& bank = banks[request.bank];
+        int ratio = config.cpuCyclesPerDramCycle;
+        long long start = cycle > bank.readyCycle ? cycle : bank.readyCycle;
+        int commandCycles = config.tCAS;
+        if (bank.openRow == request.row) {
+            rowHits++;
+        } else if (bank.openRow < 0) {
+            rowMisses++;
+            commandCycles += config.tRCD;
+        } else {
+            rowConflicts++;
+            commandCycles += config.tRP + config.tRCD;
+        }
+        long long dataStart = start + (long long)commandCycles * ratio;
+        long long& busFree = busFreeCycle[request.channel];
+        dataStart = dataStart > busFree ? dataStart : busFree;
+        long long done = dataStart + (long long)config.tBurst * ratio;
+        busFree = done;
+
+        if (config.pagePolicy == PagePolicy::Open) {
+            bank.openRow = request.row;
+            bank.readyCycle = dataStart; // Column commands to the open row pipeline
+        } else {
+            bank.openRow = -1;
+            bank.readyCycle = done + (long long)config.tRP * ratio; // Auto-precharge
+        }
+
+        if (request.write) {
+            writes++;
+        } else {
+            reads++;
+            readLatency += done - request.arrival;
+        }
+        return done;
+    }
+
+public:
+    DramController(const DramConfig& config = DramConfig(), int blockBytes = 128)
+        : config(config), reads(0), writes(0), rowHits(0), rowMisses(0), rowConflicts(0),
+          readLatency(0), peakQueue(0) {
+        int totalBanks = config.channels * config.ranks * config.banks;
+        blocksPerRow = config.rowBytes / blockBytes;
+        blocksPerRow = blocksPerRow > 0 ? blocksPerRow : 1;
+        banks.resize(totalBanks, Bank{-1, 0});
+        busFreeCycle.resize(config.channels, 0);
+        queue.reserve(64);
+    }
+
+    // Services a request immediately (blocking mode); returns its completion cycle
+    long long access(Address blockAddress, bool write, long long cycle) {
+        return service(decode(blockAddress, write, cycle), cycle);
+    }
+
+    // Queues a request arriving at cycle for the scheduler
+    void enqueue(Address blockAddress, bool write, long long arrival) {
+        queue.push_back(decode(blockAddress, write, arrival));
+        peakQueue = (int)queue.size() > peakQueue ? (int)queue.size() : peakQueue;
+    }
+
+    bool empty() const {
+        return queue.empty();
+    }
+
+    // Issues one queued request at cycle by FR-FCFS. Returns its completion cycle, or
+    // -1 if no request has arrived at a free bank.
+    long long issue(long long cycle, Address* blockAddress, bool* write) {
+        int chosen = -1;
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const Request& request = queue[i];
+            const Bank& bank = banks[request.bank];
+            if (request.arrival > cycle || bank.readyCycle > cycle) {
+                continue;
+            }
+            if (bank.openRow == request.row) {
+                chosen = (int)i; // Oldest row hit
+                break;
+            }
+            if (chosen < 0) {
+                chosen = (int)i; // Oldest ready request
+            }
+        }
+        if (chosen < 0) {
+            return -1;
+        }
+        Request request = queue[chosen];
+        queue.erase(queue.begin() + chosen);
+        *blockAddress = request.blockAddress;
+        *write = request.write;
+        return service(request, cycle);
+    }
+
+    // Earliest cycle at which a queued request could issue (-1 if the queue is empty)
+    long long nextIssueCycle() const {
+        long long next = -1;
+        for (const auto& request : queue) {
+            long long ready = banks[request.bank].readyCycle;
+            ready = request.arrival > ready ? request.arrival : ready;
+            next = (next < 0 || ready < next) ? ready : next;
+        }
+        return next;
+    }
+
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        registry.add(prefix + ".reads", &reads);
+        registry.add(prefix + ".writes", &writes);
+        registry.add(prefix + ".row_hits", &rowHits);
+        registry.add(prefix + ".row_misses", &rowMisses);
+        registry.add(prefix + ".row_conflicts", &rowConflicts);
+        registry.addRatio(prefix + ".average_read_latency", [this] {
+            return reads ? (double)readLatency / reads : 0.0;
+        });
+        registry.addGauge(prefix + ".peak_queue", [this] {
+            return peakQueue;
+        });
+    }
+
+    void printStats() const {
+        long long accesses = rowHits + rowMisses + rowConflicts;
+        std::cout << "DRAM Stats:" << std::endl;
+        std::cout << "Reads: " << reads << std::endl;
+        std::cout << "Writes: " << writes << std::endl;
+        std::cout << "Row Hits: " << rowHits << std::endl;
+        std::cout << "Row Misses: " << rowMisses << std::endl;
+        std::cout << "Row Conflicts: " << rowConflicts << std::endl;
+        std::cout << "Row Buffer Hit Rate: " << (accesses ? (double)rowHits / accesses * 100 : 0.0) << "%" << std::endl;
+        std::cout << "Average Read Latency: " << (reads ? (double)readLatency / reads : 0.0) << " cycles" << std::endl;
+        std::cout << "Peak Queue Occupancy: " << peakQueue << std::endl;
+    }
+};
+
+enum class Link {
+    L1Victim,    // L1 victims into the victim cache, victim hits back into L1
+    L1L2,        // L1 refills from L2, write buffer drains and victims into L2
+    L2Memory,    // L2 refills and prefetches from memory, writebacks and write-throughs to it
+    PrefetchFill // Blocks fetched into the prefetch cache
+};
+
+// Structures of the unified lookup chain, in search order
+enum class HitSource {
+    L1,
+    VictimCache,
+    WriteBuffer,
+    PrefetchCache,
+    L2
+};
+
+const int hitSourceCount = 5;
+
+// Byte traffic per link of the hierarchy, split into fills (toward the processor)
+// and writebacks (toward memory). With a window set, bytes are also binned into
+// fixed cycle windows to give a bandwidth series.
+class TrafficMonitor {
+private:
+    static const int linkCount = 4;
+
+    struct LinkTraffic {
+        long long fillBytes;
+        long long writebackBytes;
+        long long transfers;
+        std::vector<long long> windows; // Bytes per window of windowCycles
+    };
+
+    LinkTraffic links[linkCount];
+    long long windowCycles; // 0 disables the series
+
+public:
+    TrafficMonitor() : windowCycles(0) {
+        for (auto& link : links) {
+            link.fillBytes = 0;
+            link.writebackBytes = 0;
+            link.transfers = 0;
+        }
+    }
+
+    void setWindow(long long cycles) {
+        windowCycles = cycles;
+    }
+
+    void record(Link link, bool writeback, int bytes, long long cycle) {
+        LinkTraffic& traffic = links[(int)link];
+        if (writeback) {
+            traffic.writebackBytes += bytes;
+        } else {
+            traffic.fillBytes += bytes;
+        }
+        traffic.transfers++;
+        if (windowCycles > 0) {
+            size_t window = (size_t)(cycle / windowCycles);
+            if (window >= traffic.windows.size()) {
+                traffic.windows.resize(window + 1, 0);
+            }
+            traffic.windows[window] += bytes;
+        }
+    }
+
+    long long getBytes(Link link) const {
+        return links[(int)link].fillBytes + links[(int)link].writebackBytes;
+    }
+
+    // Bytes moved in each window; empty unless a window is set
+    const std::vector<long long>& getSeries(Link link) const {
+        return links[(int)link].windows;
+    }
+
+    void registerStats(StatsRegistry& registry, const std::string& prefix) const {
+        static const char* linkKeys[] = {"l1_victim", "l1_l2", "l2_memory", "prefetch_fill"};
+        for (int i = 0; i < linkCount; ++i) {
+            std::string link = prefix + "." + linkKeys[i];
+            registry.add(link + ".fill_bytes", &links[i].fillBytes);
+            registry.add(link + ".writeback_bytes", &links[i].writebackBytes);
+            registry.add(link + ".transfers", &links[i].transfers);
+        }
+    }
+
+    // totalCycles turns byte counts into average bandwidth (0 when untimed)
+    void printStats(long long totalCycles) const {
+        static const char* linkNames[] = {"L1-Victim", "L1-L2", "L2-Memory", "Prefetch Fill"};
+        std::cout << "Traffic Stats:" << std::endl;
+        for (int i = 0; i < linkCount; ++i) {
+            const LinkTraffic& traffic = links[i];
+            long long bytes = traffic.fillBytes + traffic.writebackBytes;
+            std::cout << linkNames[i] << " Bytes: " << bytes << " (fills: " << traffic.fillBytes
+                      << ", writebacks: " << traffic.writebackBytes << ", transfers: " << traffic.transfers << ")" << std::endl;
+            if (totalCycles > 0) {
+                long long peak = 0;
+                for (long long windowBytes : traffic.windows) {
+                    peak = windowBytes > peak ? windowBytes : peak;
+                }
+                std::cout << linkNames[i] << " Bandwidth: " << (double)bytes / totalCycles << " bytes/cycle";
+                if (windowCycles > 0) {
+                    std::cout << " (peak: " << (double)peak / windowCycles << " over " << windowCycles << "-cycle windows)";
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+};
+
+// Time series of counter snapshots taken at fixed intervals. Each sample is a row
+// of cumulative counter values copied into a ring allocated up front, so sampling
+// never allocates or formats. When the ring is full the oldest row is dropped. The
+// writers emit the leading position columns (e.g. access count and cycle) as they
+// are and every other column as its increment over the previous row.
+class IntervalStats {
+private:
+    std::vector<std::string> columns;
+    int positionColumns; // Leading columns written as absolute values
+    int capacity; // Rows kept
+    std::vector<long long> ring; // capacity rows of columns.size() values
+    std::vector<long long> base; // Row preceding the oldest kept row, zero at first
+    long long taken; // Rows recorded so far
+
+    const long long* rowAt(long long row) const {
+        return &ring[(size_t)(row % capacity) * columns.size()];
+    }
+
+    // Value written for column of kept row index (0 is the oldest kept row)
+    long long valueAt(long long index, size_t column) const {
+        long long first = taken - size();
+        long long value = rowAt(first + index)[column];
+        if ((int)column < positionColumns) {
+            return value;
+        }
+        const long long* previous = index > 0 ? rowAt(first + index - 1) : base.data();
+        return value - previous[column];
+    }
+
+public:
+    IntervalStats(const std::vector<std::string>& columns = {}, int positionColumns = 0, int capacity = 0)
+        : columns(columns), positionColumns(positionColumns), capacity(capacity > 0 ? capacity : 1),
+          ring((size_t)this->capacity * columns.size(), 0), base(columns.size(), 0), taken(0) {}
+
+    // Slot for the next sample, to be filled with cumulative values in column order
+    long long* nextRow() {
+        long long* row = &ring[(size_t)(taken % capacity) * columns.size()];
+        if (taken >= capacity) {
+            std::copy(row, row + columns.size(), base.begin()); // The dropped row becomes the base
+        }
+        taken++;
+        return row;
+    }
+
+    // Rows currently kept
+    long long size() const {
+        return taken < capacity ? taken : capacity;
+    }
+
+    long long getDropped() const {
+        return taken - size();
+    }
+
+    const std::vector<std::string>& getColumns() const {
+        return columns;
+    }
+
+    // Header line of column names, then one line per kept row
+    void writeCSV(std::ostream& out) const {
+        for (size_t c = 0; c < columns.size(); ++c) {
+            out << (c ? "," : "") << columns[c];
+        }
+        out << '\n';
+        for (long long i = 0; i < size(); ++i) {
+            for (size_t c = 0; c < columns.size(); ++c) {
+                if (c) {
+                    out << ',';
+                }
+                out << valueAt(i, c);
+            }
+            out << '\n';
+        }
+    }
+
+    // Row-major: column count (int), row count (long long), then the values of each
+    // row (long long), all native-endian
+    void writeBinary(std::ostream& out) const {
+        int count = columns.size();
+        long long rows = size();
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+        for (long long i = 0; i < rows; ++i) {
+            for (size_t c = 0; c < columns.size(); ++c) {
+                long long value = valueAt(i, c);
+                out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+        }
+    }
+
+    // Column-major: column count (int), row count (long long), each column name as a
+    // length (int) and its characters, then each column's values (long long)
+    // contiguously, so a reader can load one series without scanning the rest
+    void writeColumnar(std::ostream& out) const {
+        int count = columns.size();
+        long long rows = size();
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+        for (const auto& name : columns) {
+            int length = name.size();
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(name.data(), length);
+        }
+        for (size_t c = 0; c < columns.size(); ++c) {
+            for (long long i = 0; i < rows; ++i) {
+                long long value = valueAt(i, c);
+                out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+        }
+    }
+};
+
+// Latencies in processor cycles for the cycle-approximate timing model
+struct TimingConfig {
+    int l1HitLatency = 1;
+    int l1MissPenalty = 1; // Extra cycles to refill L1 after a miss
+    int bufferLatency = 2; // Victim cache, write buffer and prefetch cache probed in parallel
+    int l2HitLatency = 10;
+    int l2MissPenalty = 2; // Extra cycles to refill L2 after a miss
+    int memoryLatency = 100;
+    double memoryRefsPerInstruction = 0.3; // Used to turn AMAT into a CPI contribution
+};
+
+enum class InclusionPolicy {
+    Inclusive,   // L2 holds every L1 block; L2 evictions back-invalidate L1
+    Exclusive,   // A block lives in L1 or L2, never both; L1 victims fill L2
+    NonInclusive // Non-inclusive, non-exclusive (NINE)
+};
+
+class TwoLevelCache {
+private:
+    DirectMappedCache l1Cache;
+    SetAssociativeCache l2Cache;
+    WriteBuffer writeBuffer;
+    BlockBuffer victimCache;
+    BlockBuffer prefetchCache;
+    CacheBlock l1Evicted; // Block displaced by the current L1 miss, pending the victim cache swap
+    bool hasL1Evicted;
+    CacheBlock victimEvicted; // Block pushed out of the victim cache
+    long long currentCycle; // Access latencies (one cycle each without timing) plus stall cycles
+    bool timingEnabled;
+    TimingConfig timing;
+    long long accessCycles; // Sum of access latencies, excluding write buffer stalls
+    long long writeStallCycles;
+
+    // Non-blocking mode: accesses issue at their timestamps, misses overlap, and fills,
+    // writebacks and prefetches complete through the event queue at future cycles
+    bool nonBlocking;
+    EventQueue events;
+    MSHRFile l1Mshrs;
+    MSHRFile l2Mshrs;
+    MSHRFile prefetchMshrs; // Prefetches in flight to the prefetch cache
+    long long droppedPrefetches; // Prefetches not issued because every prefetch MSHR was busy
+    long long lastCompletion; // Cycle at which the last outstanding access completes
+    bool writeForwarded; // L1 forwarded the current write (write-through or write-around)
+
+    // Main memory: a fixed latency, or the DRAM model when enabled
+    bool dramEnabled;
+    DramController dram;
+    long long dramWakeup; // Cycle of the next DramSchedule event, -1 if none is pending
+
+    // Inclusion
+    InclusionPolicy inclusionPolicy;
+    long long backInvalidations; // L1-side copies removed because L2 evicted the block
+    long long dirtyBackInvalidations; // Of those, copies that had to be written to memory
+    long long exclusiveMoves; // L2 hits moved up into L1 under the exclusive policy
+
+    // Write traffic to main memory
+    long long memoryWritebacks; // Dirty blocks written back from L2
+    long long memoryWriteThroughs; // Single writes forwarded past L2
+    std::unordered_map<Address, int> accessFrequency; // Tracks access frequency for prefetching
+    GHBPrefetcher ghbPrefetcher;
+    PrefetchLevel ghbLevel;
+    std::vector<Address> ghbPrefetches; // Scratch list reused across misses
+    int currentPC;
+    long long currentTime;
+    CacheBlock prefetchScratch; // Reused to build prefetch cache entries
+
+    // Prefetch cache effectiveness
+    PrefetchThrottle prefetchThrottle;
+    int prefetchLatency; // Accesses before a prefetch cache fill would complete
+    long long prefetchCacheIssued;
+    long long prefetchCacheUseful;
+    long long prefetchCacheLate;
+    long long prefetchCacheUseless;
+
+    long long unifiedHits;
+    long long unifiedMisses;
+
+    // Hit attribution
+    long long sourceHits[hitSourceCount]; // Unified hits by the structure that supplied the block
+    long long probes; // Structures searched, summed over all accesses
+    long long probeCounts[hitSourceCount + 1]; // Accesses by number of structures searched
+    bool attributionEnabled;
+    long long locationCounts[1 << hitSourceCount]; // Accesses by mask of structures holding the block
+
+    // Bit (1 << HitSource) for every structure that holds the block before the lookup
+    int locateBlock(Address memoryAddress, Address blockAddress) {
+        int mask = 0;
+        if (l1Cache.contains(memoryAddress)) {
+            mask |= 1 << (int)HitSource::L1;
+        }
+        if (victimCache.find(blockAddress)) {
+            mask |= 1 << (int)HitSource::VictimCache;
+        }
+        if (writeBuffer.contains(blockAddress)) {
+            mask |= 1 << (int)HitSource::WriteBuffer;
+        }
+        if (prefetchCache.find(blockAddress) || (nonBlocking && prefetchMshrs.contains(blockAddress))) {
+            mask |= 1 << (int)HitSource::PrefetchCache;
+        }
+        if (l2Cache.contains(memoryAddress)) {
+            mask |= 1 << (int)HitSource::L2;
+        }
+        return mask;
+    }
+
+    static std::string locationName(int mask, const char* separator) {
+        static const char* sourceNames[] = {"L1", "Victim", "WB", "Prefetch", "L2"};
+        if (mask == 0) {
+            return "none";
+        }
+        std::string name;
+        for (int i = 0; i < hitSourceCount; ++i) {
+            if (mask & (1 << i)) {
+                name += (name.empty() ? "" : separator) + std::string(sourceNames[i]);
+            }
+        }
+        return name;
+    }
+
+    TrafficMonitor traffic;
+    int blockBytes; // 64-bit words per block times 8
+    int offsetBits; // Address bits within a block
+    int l2PrefetchesSeen; // L2 prefetches already counted as memory traffic
+
+    // Interval sampling
+    IntervalStats intervals;
+    StatsRegistry sampleStats; // Source of every sampled column
+    std::vector<size_t> sampleEntries; // sampleStats entry of each column after accesses and cycle
+    bool sampleByCycles; // Interval measured in cycles rather than accesses
+    long long sampleInterval;
+    long long nextSample; // Access count or cycle of the next sample, LLONG_MAX when off
+
+    void takeSample() {
+        long long* row = intervals.nextRow();
+        row[0] = unifiedHits + unifiedMisses;
+        row[1] = currentCycle;
+        for (size_t c = 0; c < sampleEntries.size(); ++c) {
+            row[2 + c] = sampleStats.getCount(sampleEntries[c]);
+        }
+        // An access spanning several cycle intervals closes them with one sample
+        long long progress = sampleByCycles ? currentCycle : row[0];
+        while (nextSample <= progress) {
+            nextSample += sampleInterval;
+        }
+    }
+
+    void addToVictimCache(const CacheBlock& block) {
+        // Evicts the oldest block when full; dirty victims are written back through the
+        // write buffer, clean victims fill L2 under the exclusive policy
+        traffic.record(Link::L1Victim, true, blockBytes, currentCycle);
+        if (victimCache.push(block, &victimEvicted)) {
+            if (victimEvicted.dirty) {
+                // The dirty data leaves the L1/victim cache pair here
+                l1Cache.countWriteback();
+                addToWriteBuffer(victimEvicted.tag);
+            } else if (inclusionPolicy == InclusionPolicy::Exclusive && !isHeldAbove(victimEvicted.tag << offsetBits)) {
+                l2Cache.fill(victimEvicted.tag << offsetBits, false);
+                traffic.record(Link::L1L2, true, blockBytes, currentCycle);
+            }
+        }
+    }
+
+    // Inclusive policy: remove every L1-side copy of a block L2 is evicting
+    void backInvalidate(const CacheBlock& l2Victim, Address blockAddress) {
+        Address memoryAddress = blockAddress << offsetBits;
+        bool dirty = false;
+        bool present = l1Cache.invalidate(memoryAddress, &dirty);
+        CacheBlock* victim = victimCache.find(blockAddress);
+        if (victim) {
+            dirty |= victim->dirty;
+            victimCache.remove(blockAddress);
+            present = true;
+        }
+        if (present) {
+            backInvalidations++;
+            if (dirty) {
+                dirtyBackInvalidations++;
+                if (!l2Victim.dirty) {
+                    memoryWritebacks++; // L2's own writeback covers a dirty L2 copy
+                    writeMemory(blockAddress, blockBytes);
+                }
+            }
+        }
+    }
+
+    // Charges an access in non-blocking mode. A miss to a block whose fill is still
+    // outstanding merges into its MSHR; a primary miss takes an MSHR at each level it
+    // misses in, waiting for one if all are busy. Misses are charged their latency when
+    // the fill arrives. latePrefetch marks a miss that waits for a prefetch in flight.
+    void issueNonBlocking(Address blockAddress, bool l1Missed, bool l2Missed, bool latePrefetch, int latency) {
+        long long issueCycle = currentCycle;
+        advanceTo(currentCycle); // Keeps MSHR changes in cycle order after write stalls
+        if (l1Mshrs.addWaiter(blockAddress, issueCycle)) {
+            // Secondary miss: the data arrives with the outstanding fill
+            l1Mshrs.recordMerge();
+        } else if (l1Missed) {
+            // Take every MSHR needed before allocating, so no fill lands in between
+            if (l2Missed) {
+                waitForMSHR(l2Mshrs);
+            }
+            waitForMSHR(l1Mshrs);
+            l1Mshrs.allocate(blockAddress, currentCycle);
+            l1Mshrs.addWaiter(blockAddress, issueCycle);
+            if (l2Missed) {
+                // The L2 fill schedules the L1 fill
+                l2Mshrs.allocate(blockAddress, currentCycle);
+                readMemory(blockAddress, currentCycle + latency);
+            } else if (!(latePrefetch && prefetchMshrs.addWaiter(blockAddress, issueCycle))) {
+                events.schedule(currentCycle + latency, EventType::L1Fill, blockAddress);
+            }
+        } else {
+            long long completion = currentCycle + latency;
+            lastCompletion = completion > lastCompletion ? completion : lastCompletion;
+            accessCycles += latency;
+        }
+        currentCycle++; // Issue the next access on the following cycle
+    }
+
+    // Holds the processor until the file has a free entry
+    void waitForMSHR(MSHRFile& mshrs) {
+        if (!mshrs.full()) {
+            return;
+        }
+        long long start = currentCycle;
+        while (mshrs.full()) {
+            advanceTo(currentCycle + 1);
+        }
+        mshrs.recordStall(currentCycle - start);
+    }
+
+    // Fires every event due by cycle and moves the processor clock there
+    void advanceTo(long long cycle) {
+        events.runUntil(cycle, [this](const Event& event) {
+            handleEvent(event);
+        });
+        if (cycle > currentCycle) {
+            currentCycle = cycle;
+        }
+    }
+
+    void handleEvent(const Event& event) {
+        long long waitCycles = 0;
+        switch (event.type) {
+        case EventType::L1Fill:
+            if (l1Mshrs.release(event.blockAddress, event.cycle, &waitCycles) >= 0) {
+                accessCycles += waitCycles;
+                lastCompletion = event.cycle > lastCompletion ? event.cycle : lastCompletion;
+            }
+            break;
+        case EventType::L2Fill:
+            // A demand miss refills L1 next; otherwise the read was a prefetch
+            if (l2Mshrs.release(event.blockAddress, event.cycle) >= 0) {
+                events.schedule(event.cycle + timing.l2MissPenalty, EventType::L1Fill, event.blockAddress);
+            } else if (prefetchMshrs.contains(event.blockAddress)) {
+                events.schedule(event.cycle + timing.l2MissPenalty, EventType::PrefetchFill, event.blockAddress);
+            }
+            break;
+        case EventType::Writeback:
+            writeToL2(event.blockAddress);
+            break;
+        case EventType::PrefetchFill: {
+            // A demand access that caught the prefetch in flight takes the block into L1
+            int waiters = prefetchMshrs.release(event.blockAddress, event.cycle);
+            if (waiters > 0) {
+                events.schedule(event.cycle + timing.l1MissPenalty, EventType::L1Fill, event.blockAddress);
+            } else if (waiters == 0) {
+                insertPrefetch(event.blockAddress);
+            }
+            break;
+        }
+        case EventType::DramSchedule:
+            if (event.cycle >= dramWakeup) {
+                dramWakeup = -1;
+            }
+            scheduleDram(event.cycle);
+            break;
+        }
+    }
+
+    // Reads a block from memory for a request leaving L2 at cycle. Blocking mode returns
+    // the memory latency; non-blocking mode returns 0 and delivers an L2Fill event.
+    int readMemory(Address blockAddress, long long cycle) {
+        traffic.record(Link::L2Memory, false, blockBytes, cycle);
+        if (!dramEnabled) {
+            if (nonBlocking) {
+                events.schedule(cycle + timing.memoryLatency, EventType::L2Fill, blockAddress);
+                return 0;
+            }
+            return timing.memoryLatency;
+        }
+        if (nonBlocking) {
+            dram.enqueue(blockAddress, false, cycle);
+            wakeDram(cycle);
+            return 0;
+        }
+        return (int)(dram.access(blockAddress, false, cycle) - cycle);
+    }
+
+    // Writes travel to DRAM off the critical path; the processor does not wait for them
+    void writeMemory(Address blockAddress, int bytes) {
+        traffic.record(Link::L2Memory, true, bytes, currentCycle);
+        if (!dramEnabled) {
+            return;
+        }
+        if (nonBlocking) {
+            dram.enqueue(blockAddress, true, currentCycle);
+            wakeDram(currentCycle);
+            return;
+        }
+        dram.access(blockAddress, true, currentCycle);
+    }
+
+    // Makes sure a DramSchedule event fires by cycle
+    void wakeDram(long long cycle) {
+        if (dramWakeup >= 0 && dramWakeup <= cycle) {
+            return;
+        }
+        dramWakeup = cycle;
+        events.schedule(cycle, EventType::DramSchedule, 0);
+    }
+
+    // Issues every queued DRAM request that can start at cycle; reads complete through
+    // L2Fill events
+    void scheduleDram(long long cycle) {
+        Address blockAddress;
+        bool write;
+        long long done;
+        while ((done = dram.issue(cycle, &blockAddress, &write)) >= 0) {
+            if (!write) {
+                events.schedule(done, EventType::L2Fill, blockAddress);
+            }
+        }
+        if (!dram.empty()) {
+            wakeDram(dram.nextIssueCycle());
+        }
+    }
+
+    void drainToL2(Address blockAddress) {
+        traffic.record(Link::L1L2, true, blockBytes, currentCycle);
+        if (nonBlocking) {
+            // The drained entry reaches L2 after the L2 access latency
+            events.schedule(currentCycle + timing.l2HitLatency, EventType::Writeback, blockAddress);
+            return;
+        }
+        writeToL2(blockAddress);
+    }
+
+    void writeToL2(Address blockAddress) {
+        Address memoryAddress = blockAddress << offsetBits;
+        if (inclusionPolicy == InclusionPolicy::Exclusive) {
+            // A block held above takes the write instead of duplicating it in L2
+            if (l1Cache.contains(memoryAddress)) {
+                l1Cache.markDirty(memoryAddress);
+                return;
+            }
+            CacheBlock* victim = victimCache.find(blockAddress);
+            if (victim) {
+                victim->dirty = true;
+                return;
+            }
+        }
+        l2Cache.writeback(memoryAddress);
+    }
+
+    void addToWriteBuffer(Address blockAddress) {
+        // The processor is held until the buffer accepts the write
+        long long stall = writeBuffer.write(blockAddress, currentCycle);
+        currentCycle += stall;
+        writeStallCycles += stall;
+    }
+
+    void addToPrefetchCache(Address blockAddress) {
+        if (prefetchCache.find(blockAddress)) {
+            return; // Already buffered
+        }
+        if (nonBlocking) {
+            // Fetch the block from L2 (or memory) and fill it when it arrives
+            if (prefetchMshrs.contains(blockAddress) || l1Mshrs.contains(blockAddress)) {
+                return; // Already in flight
+            }
+            if (prefetchMshrs.full()) {
+                droppedPrefetches++;
+                return;
+            }
+            prefetchMshrs.allocate(blockAddress, currentCycle);
+            if (l2Cache.contains(blockAddress << offsetBits)) {
+                events.schedule(currentCycle + timing.l2HitLatency, EventType::PrefetchFill, blockAddress);
+            } else {
+                readMemory(blockAddress, currentCycle + timing.l2HitLatency); // L2Fill forwards it
+            }
+        } else {
+            if (!l2Cache.contains(blockAddress << offsetBits)) {
+                readMemory(blockAddress, currentCycle);
+            }
+            insertPrefetch(blockAddress);
+        }
+        traffic.record(Link::PrefetchFill, false, blockBytes, currentCycle);
+        prefetchCacheIssued++;
+        prefetchThrottle.recordIssued();
+    }
+
+    void insertPrefetch(Address blockAddress) {
+        if (prefetchCache.find(blockAddress)) {
+            return;
+        }
+        if (prefetchCache.full()) {
+            // Evict the oldest block
+            if (prefetchCache.front().prefetched) {
+                prefetchCacheUseless++;
+            }
+            prefetchCache.pop();
+        }
+        CacheBlock& block = prefetchScratch;
+        block.valid = true;
+        block.dirty = false;
+        block.tag = blockAddress;
+        block.prefetched = true;
+        block.prefetchTime = currentTime;
+        prefetchCache.push(block);
+    }
+
+public:
+    TwoLevelCache(int l1NumBlocks, int l1BlockSize, int l2NumBlocks, int l2BlockSize, int l2Ways)
+        : l1Cache(l1NumBlocks, l1BlockSize), l2Cache(l2NumBlocks, l2BlockSize, l2Ways),
+          writeBuffer(4), victimCache(4), prefetchCache(4),
+          hasL1Evicted(false), currentCycle(0), timingEnabled(false), accessCycles(0),
+          writeStallCycles(0), nonBlocking(false), droppedPrefetches(0), lastCompletion(0), writeForwarded(false),
+          dramEnabled(false), dramWakeup(-1), inclusionPolicy(InclusionPolicy::NonInclusive), backInvalidations(0), dirtyBackInvalidations(0), exclusiveMoves(0),
+          memoryWritebacks(0), memoryWriteThroughs(0), ghbLevel(PrefetchLevel::None), currentPC(0), currentTime(0),
+          prefetchThrottle(4, 4), prefetchLatency(1),
+          prefetchCacheIssued(0), prefetchCacheUseful(0), prefetchCacheLate(0), prefetchCacheUseless(0),
+          unifiedHits(0), unifiedMisses(0), sourceHits(), probes(0), probeCounts(), attributionEnabled(false), locationCounts(),
+          blockBytes(l1BlockSize * wordBytes),
+          offsetBits(l1Cache.getOffsetBits()), l2PrefetchesSeen(0), sampleByCycles(false), sampleInterval(0),
+          nextSample(LLONG_MAX) {
+        // Set up the eviction callback for L1 cache. The block is held until the
+        // victim cache has been searched so a victim hit can swap with it.
+        l1Cache.onEvict = [this](const CacheBlock& block, Address blockAddress) {
+            l1Evicted.valid = block.valid;
+            l1Evicted.dirty = block.dirty;
+            l1Evicted.prefetched = false;
+            l1Evicted.tag = blockAddress;
+            l1Evicted.lastAccessTime = block.lastAccessTime;
+            hasL1Evicted = true;
+        };
+
+        writeBuffer.onDrain = [this](Address blockAddress) {
+            drainToL2(blockAddress);
+        };
+
+        // Writes L1 forwards are buffered once the lookup chain has finished
+        l1Cache.onWriteThrough = [this](Address) {
+            writeForwarded = true;
+        };
+        l2Cache.onWriteback = [this](Address memoryAddress) {
+            memoryWritebacks++;
+            writeMemory(memoryAddress >> offsetBits, blockBytes);
+        };
+        l2Cache.onWriteThrough = [this](Address memoryAddress) {
+            memoryWriteThroughs++;
+            writeMemory(memoryAddress >> offsetBits, wordBytes);
+        };
+    }
+
+    void setL1WritePolicy(WriteHitPolicy hitPolicy, WriteMissPolicy missPolicy) {
+        l1Cache.setWritePolicy(hitPolicy, missPolicy);
+    }
+
+    void setL2WritePolicy(WriteHitPolicy hitPolicy, WriteMissPolicy missPolicy) {
+        l2Cache.setWritePolicy(hitPolicy, missPolicy);
+    }
+
+    // Resizes the write buffer; drainInterval is the number of cycles per entry
+    // drained to L2 (0 drains only to make room)
+    void setWriteBuffer(int capacity, int drainInterval) {
+        writeBuffer = WriteBuffer(capacity, drainInterval);
+        writeBuffer.onDrain = [this](Address blockAddress) {
+            drainToL2(blockAddress);
+        };
+    }
+
+    // Enables the cycle-approximate timing model; accesses then take their latency in cycles
+    void setTiming(const TimingConfig& config) {
+        timing = config;
+        timingEnabled = true;
+    }
+
+    // Bins link traffic into windows of the given number of cycles for bandwidth
+    // series; only meaningful with the timing model on
+    void setBandwidthWindow(long long cycles) {
+        traffic.setWindow(cycles);
+    }
+
+    const TrafficMonitor& getTraffic() const {
+        return traffic;
+    }
+
+    // Snapshots every counter and gauge of registerStats every interval accesses (or
+    // cycles) into a ring of capacity samples; an interval of 0 turns sampling off.
+    // Columns are fixed here, so enable optional statistics (miss classification, hit
+    // attribution) first.
+    void setSampling(long long interval, bool byCycles = false, int capacity = 4096) {
+        sampleStats = StatsRegistry();
+        registerStats(sampleStats);
+        sampleEntries.clear();
+        std::vector<std::string> columns = {"accesses", "cycle"};
+        int absoluteColumns = 0;
+        // Gauges join the absolute-valued leading columns; counters follow as increments
+        for (bool gauges : {true, false}) {
+            for (size_t i = 0; i < sampleStats.size(); ++i) {
+                if (!sampleStats.isRatio(i) && sampleStats.isGauge(i) == gauges) {
+                    columns.push_back(sampleStats.getName(i));
+                    sampleEntries.push_back(i);
+                }
+            }
+            if (gauges) {
+                absoluteColumns = (int)columns.size();
+            }
+        }
+        intervals = IntervalStats(columns, absoluteColumns, capacity);
+        sampleByCycles = byCycles;
+        sampleInterval = interval;
+        long long now = byCycles ? currentCycle : unifiedHits + unifiedMisses;
+        nextSample = interval > 0 ? now + interval : LLONG_MAX;
+    }
+
+    const IntervalStats& getIntervalStats() const {
+        return intervals;
+    }
+
+    // Registers every counter of the hierarchy by name. The registry points at this
+    // object's counters and must not outlive it.
+    void registerStats(StatsRegistry& registry) const {
+        l1Cache.registerStats(registry, "l1");
+        l2Cache.registerStats(registry, "l2");
+        registry.add("unified.hits", &unifiedHits);
+        registry.add("unified.misses", &unifiedMisses);
+        registry.addRatio("unified.hit_rate", [this] {
+            return (double)unifiedHits / (unifiedHits + unifiedMisses);
+        });
+        static const char* sourceKeys[] = {"l1", "victim_cache", "write_buffer", "prefetch_cache", "l2"};
+        for (int i = 0; i < hitSourceCount; ++i) {
+            registry.add(std::string("hits.") + sourceKeys[i], &sourceHits[i]);
+        }
+        registry.add("probes.total", &probes);
+        for (int i = 1; i <= hitSourceCount; ++i) {
+            registry.add("probes.accesses_with_" + std::to_string(i), &probeCounts[i]);
+        }
+        for (int mask = 0; attributionEnabled && mask < (1 << hitSourceCount); ++mask) {
+            std::string name = locationName(mask, "_");
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            registry.add("locations." + name, &locationCounts[mask]);
+        }
+        writeBuffer.registerStats(registry, "write_buffer");
+        registry.add("victim_cache.hits", &sourceHits[(int)HitSource::VictimCache]);
+        registry.add("timing.access_cycles", &accessCycles);
+        registry.add("timing.write_stall_cycles", &writeStallCycles);
+        registry.addCounter("timing.total_cycles", [this] {
+            return lastCompletion > currentCycle ? lastCompletion : currentCycle;
+        });
+        registry.addCounter("timing.events_processed", [this] {
+            return events.getFired();
+        });
+        registry.add("timing.dropped_prefetches", &droppedPrefetches);
+        l1Mshrs.registerStats(registry, "l1_mshr");
+        l2Mshrs.registerStats(registry, "l2_mshr");
+        dram.registerStats(registry, "dram");
+        registry.add("inclusion.back_invalidations", &backInvalidations);
+        registry.add("inclusion.dirty_back_invalidations", &dirtyBackInvalidations);
+        registry.add("inclusion.exclusive_moves", &exclusiveMoves);
+        registry.add("memory.writebacks", &memoryWritebacks);
+        registry.add("memory.write_throughs", &memoryWriteThroughs);
+        traffic.registerStats(registry, "traffic");
+        registry.add("prefetch_cache.hits", &sourceHits[(int)HitSource::PrefetchCache]);
+        registry.add("prefetch_cache.issued", &prefetchCacheIssued);
+        registry.add("prefetch_cache.useful", &prefetchCacheUseful);
+        registry.add("prefetch_cache.late", &prefetchCacheLate);
+        registry.add("prefetch_cache.useless", &prefetchCacheUseless);
+        ghbPrefetcher.registerStats(registry, "ghb");
+    }
+
+    void writeStatsJSON(std::ostream& out) const {
+        StatsRegistry registry;
+        registerStats(registry);
+        registry.writeJSON(out);
+    }
+
+    void writeStatsCSV(std::ostream& out) const {
+        StatsRegistry registry;
+        registerStats(registry);
+        registry.writeCSV(out);
+    }
+
+    long long getCurrentCycle() const {
+        return currentCycle;
+    }
+
+    // Makes both levels non-blocking with the given number of MSHRs. Accesses then issue
+    // at their timestamps, misses overlap, and the processor only stalls for a free MSHR.
+    // Enables the timing model with default latencies if it is not already on.
+    void setMSHRs(int l1Entries, int l2Entries, int prefetchEntries = 8) {
+        l1Mshrs = MSHRFile(l1Entries);
+        l2Mshrs = MSHRFile(l2Entries);
+        prefetchMshrs = MSHRFile(prefetchEntries);
+        nonBlocking = true;
+        timingEnabled = true;
+    }
+
+    // Replaces the fixed memory latency with the DRAM model. L2 misses, prefetches that
+    // miss in L2 and writes to memory become DRAM requests; in non-blocking mode they
+    // queue at the controller and are scheduled FR-FCFS. Enables the timing model with
+    // default latencies if it is not already on.
+    void setDram(const DramConfig& config) {
+        dram = DramController(config, l2Cache.getBlockSize() * wordBytes);
+        dramEnabled = true;
+        timingEnabled = true;
+    }
+
+    // Completes every outstanding fill, writeback and prefetch in non-blocking mode so
+    // the timing stats cover them; call before printStats
+    void drain() {
+        long long cycle = currentCycle;
+        while (events.getPending() > 0) {
+            cycle += 1024;
+            events.runUntil(cycle, [this](const Event& event) {
+                handleEvent(event);
+            });
+        }
+    }
+
+    // Selects word or byte addresses for both levels; call before the first access
+    void setAddressMode(AddressMode mode) {
+        l1Cache.setAddressMode(mode);
+        l2Cache.setAddressMode(mode);
+        offsetBits = l1Cache.getOffsetBits();
+    }
+
+    // Turns on 3C miss classification for both levels
+    void enableMissClassification() {
+        l1Cache.enableMissClassification();
+        l2Cache.enableMissClassification();
+    }
+
+    // Selects the set index function of each level; call before the first access
+    void setIndexFunction(IndexFunction l1Function, IndexFunction l2Function) {
+        l1Cache.setIndexFunction(l1Function);
+        l2Cache.setIndexFunction(l2Function);
+    }
+
+    // Turns on the per-set heat map for both levels
+    void enableSetHeatMap() {
+        l1Cache.enableSetHeatMap();
+        l2Cache.enableSetHeatMap();
+    }
+
+    // Records, for every access, which combination of structures held the block
+    // before the lookup, and reports the hit attribution. Costs one side-effect-free
+    // search of every structure per access.
+    void enableHitAttribution() {
+        attributionEnabled = true;
+    }
+
+    long long getSourceHits(HitSource source) const {
+        return sourceHits[(int)source];
+    }
+
+    // Accesses that found the block in exactly the structures of mask (bit 1 << HitSource)
+    long long getLocationCount(int mask) const {
+        return attributionEnabled ? locationCounts[mask] : 0;
+    }
+
+    long long getProbes() const {
+        return probes;
+    }
+
+    const DirectMappedCache& getL1Cache() const {
+        return l1Cache;
+    }
+
+    const SetAssociativeCache& getL2Cache() const {
+        return l2Cache;
+    }
+
+    // True when L1 or the victim cache holds the block
+    bool isHeldAbove(Address memoryAddress) const {
+        return l1Cache.contains(memoryAddress) || victimCache.contains(memoryAddress >> offsetBits);
+    }
+
+    void setInclusionPolicy(InclusionPolicy policy) {
+        inclusionPolicy = policy;
+        l2Cache.allocateOnMiss = (policy != InclusionPolicy::Exclusive);
+        if (policy == InclusionPolicy::Exclusive) {
+            // L2 prefetches must not duplicate blocks held in L1 or the victim cache
+            l2Cache.heldAbove = [this](Address memoryAddress) {
+                return isHeldAbove(memoryAddress);
+            };
+        } else {
+            l2Cache.heldAbove = nullptr;
+        }
+        if (policy == InclusionPolicy::Inclusive) {
+            l2Cache.onEvict = [this](const CacheBlock& block, Address blockAddress) {
+                backInvalidate(block, blockAddress);
+            };
+        } else {
+            l2Cache.onEvict = nullptr;
+        }
+    }
+
+    // Attaches a GHB prefetcher to the miss path of the given level
+    void setGHBPrefetcher(PrefetchLevel level, GHBMode mode, int historySize = 256, int indexSize = 256, int degree = 4) {
+        ghbPrefetcher = GHBPrefetcher(mode, historySize, indexSize, degree);
+        ghbLevel = level;
+        ghbPrefetches.reserve(degree);
+        l1Cache.onMiss = nullptr;
+        l2Cache.onMiss = nullptr;
+
+        if (level == PrefetchLevel::L1) {
+            l1Cache.onMiss = [this](Address memoryAddress) {
+                SIM_PROFILE_SCOPE(Prefetch);
+                ghbPrefetches.clear();
+                ghbPrefetcher.onMiss(memoryAddress >> offsetBits, currentPC, ghbPrefetches);
+                int count = prefetchThrottle.limit((int)ghbPrefetches.size());
+                for (int i = 0; i < count; ++i) {
+                    addToPrefetchCache(ghbPrefetches[i]);
+                }
+            };
+        } else if (level == PrefetchLevel::L2) {
+            // Trained on L2 block addresses, which differ from L1's when the block sizes do
+            l2Cache.onMiss = [this](Address memoryAddress) {
+                SIM_PROFILE_SCOPE(Prefetch);
+                int l2OffsetBits = l2Cache.getOffsetBits();
+                ghbPrefetches.clear();
+                ghbPrefetcher.onMiss(memoryAddress >> l2OffsetBits, currentPC, ghbPrefetches);
+                int count = l2Cache.getPrefetchLimit((int)ghbPrefetches.size());
+                for (int i = 0; i < count; ++i) {
+                    l2Cache.prefetch(ghbPrefetches[i] << l2OffsetBits);
+                }
+            };
+        }
+    }
+
+    // Enables feedback-directed throttling for the prefetch cache and the L2 prefetcher
+    void setPrefetchThrottling(bool enabled, int interval = 256) {
+        prefetchThrottle = PrefetchThrottle(prefetchThrottle.getDegree(), 4, interval);
+        prefetchThrottle.enable(enabled);
+        l2Cache.setPrefetchThrottling(enabled, 4, interval);
+    }
+
+    // Timestamped access: in non-blocking mode the access issues at issueCycle (or when
+    // the processor is free, if later)
+    void access(Address memoryAddress, bool write, int pc, long long issueCycle) {
+        if (issueCycle > currentCycle) {
+            currentCycle = issueCycle;
+        }
+        access(memoryAddress, write, pc);
+    }
+
+    void access(Address memoryAddress, bool write, int pc = 0) {
+        bool isUnifiedHit = false;
+        bool l1Missed = false;
+        bool l2Missed = false;
+        bool latePrefetch = false;
+        HitSource source = HitSource::L1;
+        int probed = 1;
+        Address blockAddress = memoryAddress >> offsetBits;
+        bool l1Allocated = !(write && l1Cache.getWriteMissPolicy() == WriteMissPolicy::NoWriteAllocate);
+        currentPC = pc;
+        currentTime++;
+        hasL1Evicted = false;
+        writeForwarded = false;
+        SIM_PROFILE_STAGE(Timing);
+        if (nonBlocking) {
+            advanceTo(currentCycle);
+        }
+        writeBuffer.advance(currentCycle);
+        int latency = timing.l1HitLatency;
+        if (attributionEnabled) {
+            SIM_PROFILE_STAGE(StatsUpdate);
+            locationCounts[locateBlock(memoryAddress, blockAddress)]++;
+        }
+
+        // Check L1 cache
+        SIM_PROFILE_STAGE(L1Lookup);
+        bool l1Hit = l1Cache.access(memoryAddress, write);
+        SIM_PROFILE_STAGE(BufferSearch);
+        if (l1Hit) {
+            isUnifiedHit = true;
+        } else {
+            l1Missed = true;
+            prefetchThrottle.recordMiss();
+            latency += timing.l1MissPenalty + timing.bufferLatency;
+
+            // Check victim cache; on a hit the block moves back into L1 and the
+            // block it displaced takes its place (unless L1 wrote around the miss)
+            CacheBlock* victim = victimCache.find(blockAddress);
+            probed++;
+            if (victim) {
+                isUnifiedHit = true;
+                source = HitSource::VictimCache;
+                if (l1Allocated) {
+                    if (victim->dirty) {
+                        l1Cache.markDirty(memoryAddress);
+                    }
+                    victimCache.remove(blockAddress);
+                    traffic.record(Link::L1Victim, false, blockBytes, currentCycle);
+                }
+            }
+            if (hasL1Evicted) {
+                addToVictimCache(l1Evicted);
+                hasL1Evicted = false;
+            }
+
+            if (!isUnifiedHit) {
+                // Check write buffer (writes coalesce into the entry, reads are forwarded)
+                probed++;
+                if (write ? writeBuffer.contains(blockAddress) : writeBuffer.forward(blockAddress)) {
+                    isUnifiedHit = true;
+                    source = HitSource::WriteBuffer;
+                }
+
+                if (!isUnifiedHit) {
+                    // Check prefetch cache
+                    CacheBlock* block = prefetchCache.find(blockAddress);
+                    bool inFlight = nonBlocking && prefetchMshrs.contains(blockAddress);
+                    probed++;
+                    if (block) {
+                        isUnifiedHit = true;
+                        source = HitSource::PrefetchCache;
+                        if (block->prefetched) {
+                            // Without the event queue a fill within prefetchLatency accesses counts as late
+                            bool late = !nonBlocking && currentTime - block->prefetchTime < prefetchLatency;
+                            prefetchCacheUseful++;
+                            if (late) {
+                                prefetchCacheLate++;
+                            }
+                            prefetchThrottle.recordUseful(late);
+                            block->prefetched = false;
+                        }
+                    } else if (inFlight) {
+                        // Late prefetch: wait for the fill already in flight and take the block
+                        isUnifiedHit = true;
+                        source = HitSource::PrefetchCache;
+                        latePrefetch = true;
+                        prefetchCacheUseful++;
+                        prefetchCacheLate++;
+                        prefetchThrottle.recordUseful(true);
+                    }
+                }
+
+                if (!isUnifiedHit && (l1Allocated || !writeForwarded)) {
+                    // Check L2 cache. L2 only supplies the block, so even a write miss is
+                    // a read for ownership: the store stays in L1 (write-back) or reaches
+                    // L2 through the write buffer (forwarded)
+                    SIM_PROFILE_STAGE(L2Lookup);
+                    latency += timing.l2HitLatency;
+                    probed++;
+                    if (l1Allocated) {
+                        traffic.record(Link::L1L2, false, blockBytes, currentCycle);
+                    }
+                    if (l2Cache.access(memoryAddress, false)) {
+                        isUnifiedHit = true;
+                        source = HitSource::L2;
+                        if (inclusionPolicy == InclusionPolicy::Exclusive && l1Allocated) {
+                            // Move the block up into L1
+                            bool dirty = false;
+                            l2Cache.invalidate(memoryAddress, &dirty);
+                            if (dirty) {
+                                l1Cache.markDirty(memoryAddress);
+                            }
+                            exclusiveMoves++;
+                        }
+                    } else {
+                        l2Missed = true;
+                        if (inclusionPolicy == InclusionPolicy::Inclusive && l1Allocated && !l2Cache.contains(memoryAddress)) {
+                            // L2 did not allocate (write-around); keep L1 a subset of L2
+                            l1Cache.invalidate(memoryAddress);
+                        }
+                    }
+                } else if (isUnifiedHit && inclusionPolicy == InclusionPolicy::Inclusive && l1Allocated) {
+                    // Block supplied by the write buffer or prefetch cache must also be in L2
+                    SIM_PROFILE_STAGE(L2Lookup);
+                    l2Cache.fill(memoryAddress, false);
+                } else if (isUnifiedHit && inclusionPolicy == InclusionPolicy::Exclusive && l1Allocated) {
+                    // Block supplied by the write buffer or prefetch cache leaves L2
+                    SIM_PROFILE_STAGE(L2Lookup);
+                    bool dirty = false;
+                    if (l2Cache.invalidate(memoryAddress, &dirty) && dirty) {
+                        l1Cache.markDirty(memoryAddress);
+                    }
+                }
+            }
+        }
+
+        // Update access frequency for prefetching
+        SIM_PROFILE_STAGE(Prefetch);
+        accessFrequency[blockAddress]++;
+        if (accessFrequency[blockAddress] >= 2 && prefetchThrottle.getDegree() > 0) {
+            // Add to prefetch cache if accessed 2 or more times
+            addToPrefetchCache(blockAddress);
+        }
+
+        // Writes L1 forwarded (write-through or write-around) go to L2 through the write
+        // buffer; a write L1 allocated stays in L1 until its dirty block is evicted
+        if (writeForwarded) {
+            SIM_PROFILE_STAGE(BufferSearch);
+            addToWriteBuffer(blockAddress);
+        }
+
+        // Blocks the L2 prefetcher brought in from memory during this access
+        SIM_PROFILE_STAGE(StatsUpdate);
+        while (l2PrefetchesSeen < l2Cache.getPrefetchesIssued()) {
+            traffic.record(Link::L2Memory, false, blockBytes, currentCycle);
+            l2PrefetchesSeen++;
+        }
+
+        if (isUnifiedHit) {
+            unifiedHits++;
+            sourceHits[(int)source]++;
+        } else {
+            unifiedMisses++;
+        }
+        probes += probed;
+        probeCounts[probed]++;
+
+        SIM_PROFILE_STAGE(Timing);
+        if (nonBlocking) {
+            issueNonBlocking(blockAddress, l1Missed && (l1Allocated || !writeForwarded), l2Missed, latePrefetch, latency);
+        } else {
+            if (l2Missed) {
+                // Forwarded write-arounds stop at the write buffer and never miss in L2
+                latency += timing.l2MissPenalty + readMemory(blockAddress, currentCycle + latency);
+            }
+            accessCycles += latency;
+            currentCycle += timingEnabled ? latency : 1;
+        }
+
+        if ((sampleByCycles ? currentCycle : unifiedHits + unifiedMisses) >= nextSample) {
+            SIM_PROFILE_STAGE(StatsUpdate);
+            takeSample();
+        }
+        SIM_PROFILE_STAGE(Outside);
+    }
+
+    void printHitAttribution() const {
+        static const char* sourceNames[] = {"L1", "Victim Cache", "Write Buffer", "Prefetch Cache", "L2"};
+        long long accesses = unifiedHits + unifiedMisses;
+        std::cout << "Hit Attribution:" << std::endl;
+        for (int i = 0; i < hitSourceCount; ++i) {
+            std::cout << sourceNames[i] << " Hits: " << sourceHits[i] << std::endl;
+        }
+        std::cout << "Average Probes per Access: " << (accesses ? (double)probes / accesses : 0.0) << " (";
+        for (int i = 1; i <= hitSourceCount; ++i) {
+            std::cout << (i > 1 ? ", " : "") << i << ": " << probeCounts[i];
+        }
+        std::cout << ")" << std::endl;
+        std::vector<int> masks;
+        for (int mask = 0; mask < (1 << hitSourceCount); ++mask) {
+            if (locationCounts[mask] > 0) {
+                masks.push_back(mask);
+            }
+        }
+        std::stable_sort(masks.begin(), masks.end(), [this](int a, int b) {
+            return locationCounts[a] > locationCounts[b];
+        });
+        std::cout << "Block Locations:" << std::endl;
+        for (int mask : masks) {
+            std::cout << locationName(mask, "+") << ": " << locationCounts[mask] << std::endl;
+        }
+    }
+
+    void printStats() const {
+        // std::cout << "L1 Cache Stats:" << std::endl;
+        l1Cache.printStats("L1");
+
+        // std::cout << "L2 Cache Stats:" << std::endl;
+        l2Cache.printStats("L2");
+
+        std::cout << "Overall Unified Cache Stats:" << std::endl;
+        std::cout << "Unified Hits: " << unifiedHits << std::endl;
+        std::cout << "Unified Misses: " << unifiedMisses << std::endl;
+        std::cout << "Unified Hit Rate: " << (double)unifiedHits / (unifiedHits + unifiedMisses) * 100 << "%" << std::endl;
+        if (attributionEnabled) {
+            printHitAttribution();
+        }
+
+        writeBuffer.printStats();
+
+        if (timingEnabled) {
+            long long accesses = unifiedHits + unifiedMisses;
+            double amat = accesses ? (double)accessCycles / accesses : 0.0;
+            double instructions = accesses / timing.memoryRefsPerInstruction;
+            double stallCycles = (double)(accessCycles - accesses * timing.l1HitLatency) + writeStallCycles;
+            std::cout << "Timing Stats:" << std::endl;
+            std::cout << "Total Cycles: " << (lastCompletion > currentCycle ? lastCompletion : currentCycle) << std::endl;
+            std::cout << "AMAT: " << amat << " cycles" << std::endl;
+            std::cout << "Memory Stall CPI: " << (instructions > 0 ? stallCycles / instructions : 0.0) << std::endl;
+            if (nonBlocking) {
+                std::cout << "Events Processed: " << events.getFired() << std::endl;
+                l1Mshrs.printStats("L1");
+                l2Mshrs.printStats("L2");
+                std::cout << "Dropped Prefetches: " << droppedPrefetches << std::endl;
+            }
+            if (dramEnabled) {
+                dram.printStats();
+            }
+        }
+
+        static const char* inclusionNames[] = {"Inclusive", "Exclusive", "Non-Inclusive"};
+        int l1Blocks = l1Cache.countValidBlocks();
+        int l2Blocks = l2Cache.countValidBlocks();
+        int duplicated = 0;
+        const std::vector<CacheBlock>& l1Lines = l1Cache.getBlocks();
+        for (size_t line = 0; line < l1Lines.size(); ++line) {
+            if (l1Lines[line].valid && l2Cache.contains(l1Cache.getBlockAddress(line) << offsetBits)) {
+                duplicated++;
+            }
+        }
+        std::cout << "Inclusion Policy: " << inclusionNames[(int)inclusionPolicy] << std::endl;
+        std::cout << "Back-Invalidations: " << backInvalidations << " (dirty: " << dirtyBackInvalidations << ")" << std::endl;
+        if (inclusionPolicy == InclusionPolicy::Exclusive) {
+            std::cout << "L2 to L1 Moves: " << exclusiveMoves << std::endl;
+        }
+        std::cout << "Effective Capacity (distinct blocks): " << l1Blocks + l2Blocks - duplicated << std::endl;
+
+        std::cout << "Memory Write Traffic:" << std::endl;
+        std::cout << "Writebacks: " << memoryWritebacks << std::endl;
+        std::cout << "Write-Throughs: " << memoryWriteThroughs << std::endl;
+        std::cout << "Bytes Written: " << (long long)memoryWritebacks * blockBytes + (long long)memoryWriteThroughs * wordBytes << std::endl;
+
+        long long totalCycles = lastCompletion > currentCycle ? lastCompletion : currentCycle;
+        traffic.printStats(timingEnabled ? totalCycles : 0);
+
+        std::cout << "Prefetch Cache Stats:" << std::endl;
+        std::cout << "Prefetches Issued: " << prefetchCacheIssued << std::endl;
+        std::cout << "Useful Prefetches: " << prefetchCacheUseful << " (late: " << prefetchCacheLate << ")" << std::endl;
+        std::cout << "Useless Prefetches: " << prefetchCacheUseless << std::endl;
+
+        if (ghbLevel != PrefetchLevel::None) {
+            std::cout << "GHB Prefetcher (" << (ghbLevel == PrefetchLevel::L1 ? "L1" : "L2") << "):" << std::endl;
+            std::cout << "Trained Misses: " << ghbPrefetcher.getTrainedMisses() << std::endl;
+            std::cout << "Issued Prefetches: " << ghbPrefetcher.getIssuedPrefetches() << std::endl;
+        }
+    }
+};
+
+// One access of a multi-threaded trace
+struct TraceRecord {
+    int core;
+    Address memoryAddress;
+    bool write;
+};
+
+enum class CoherenceState {
+    Invalid,
+    Shared,
+    Exclusive,
+    Modified
+};
+
+// Reusable barrier for a fixed number of threads
+class Barrier {
+private:
+    std::mutex lock;
+    std::condition_variable released;
+    int count;
+    int waiting;
+    long long generation;
+
+public:
+    explicit Barrier(int count) : count(count), waiting(0), generation(0) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        long long arrived = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            generation++;
+            released.notify_all();
+            return;
+        }
+        released.wait(guard, [&] { return generation != arrived; });
+    }
+};
+
+// Cores with private direct-mapped L1s in front of a shared set-associative L2, kept
+// coherent by a MESI directory. The directory records which L1s hold each block and
+// which core, if any, holds it exclusively; an exclusive copy is M when the L1 has it
+// dirty and E otherwise. Private L1s are write-back, write-allocate.
+//
+// Shared state is split into lock stripes by block address modulo the stripe count,
+// which divides both the L1 size and the L2 set count. Every L1 line, directory entry
+// and L2 set a block can touch (its own and its victims') then lies in the block's
+// stripe, so one stripe lock covers a whole access and accesses to different stripes
+// run in parallel.
+//
+// Coherence misses are split into true and false sharing with 16-bit word masks kept
+// per L1 line. A line records the words its core has written since it last published
+// them, and a line whose copy was invalidated records the words other cores have
+// written since. Writes are published to the invalidated copies whenever the writer's
+// copy is downgraded, invalidated or evicted, which always happens before another core
+// can miss on the block. A coherence miss is true sharing if it accesses a word
+// written since the invalidation, false sharing otherwise.
+class MultiCoreCache {
+private:
+    struct DirectoryEntry {
+        unsigned long long sharers; // One bit per core holding the block
+        int owner; // Core holding the block in E or M, -1 if none
+        unsigned long long invalidated; // Cores whose copy a remote write invalidated
+    };
+
+    struct LineSharing {
+        unsigned long long written; // Words this core wrote and has not yet published
+        unsigned long long missed; // Words others wrote since this core's copy was invalidated
+        Address invalidatedBlock; // Block whose copy was invalidated in this line, InvalidAddress if none
+    };
+
+    struct SharingMisses {
+        long long trueSharing;
+        long long falseSharing;
+    };
+
+    struct CoherenceStats {
+        long long readRequests; // GetS: read misses
+        long long writeRequests; // GetM: write misses
+        long long upgrades; // Write hits on S copies
+        long long invalidations; // Remote copies invalidated
+        long long downgrades; // Remote E or M copies reduced to S by a read
+        long long cacheToCache; // Misses supplied by a dirty remote copy
+        long long l1Writebacks; // Dirty L1 data written to L2
+        long long trueSharingMisses;
+        long long falseSharingMisses;
+    };
+
+    struct Stripe {
+        std::mutex lock;
+        std::unordered_map<Address, DirectoryEntry> directory; // Blocks of the stripe cached in some L1
+        SetAssociativeCache l2Cache; // The stripe's L2 sets
+        CoherenceStats stats;
+        std::unordered_map<Address, SharingMisses> sharingMisses; // Per block with coherence misses
+
+        Stripe(int l2NumBlocks, int l2BlockSize, int l2Ways) : l2Cache(l2NumBlocks, l2BlockSize, l2Ways), stats() {}
+    };
+
+    std::vector<DirectMappedCache> l1Caches;
+    std::vector<std::unique_ptr<Stripe>> stripes;
+    int numCores;
+    int numStripes;
+    std::vector<long long> coherenceMisses; // Per core: misses to blocks lost to invalidation
+    std::vector<std::vector<LineSharing>> lineSharing; // Per core and L1 line
+    int l1NumBlocks;
+    int offsetBits; // Address bits within a block
+    int wordShift; // Address bits within a word
+
+    Stripe& stripeOf(Address blockAddress) {
+        return *stripes[blockAddress % numStripes];
+    }
+
+    // Address of the block within its stripe's L2 slice; slice set i is L2 set
+    // i * numStripes + stripe, so the slices together behave as one L2
+    Address sliceAddress(Address memoryAddress) const {
+        Address offsetMask = (Address(1) << offsetBits) - 1;
+        return (((memoryAddress >> offsetBits) / numStripes) << offsetBits) | (memoryAddress & offsetMask);
+    }
+
+    // Bit of the accessed word in a line's word masks, one bit per word of the block
+    unsigned long long wordBit(Address memoryAddress) const {
+        Address wordMask = (Address(1) << (offsetBits - wordShift)) - 1;
+        return 1ULL << ((memoryAddress >> wordShift) & wordMask);
+    }
+
+    // L1 line a block maps to; every core's L1 has the same geometry
+    int lineOf(Address blockAddress) const {
+        return l1Caches[0].lineOf(blockAddress << offsetBits);
+    }
+
+    // Publishes the words a core wrote into its copy of the block to every copy that
+    // stands invalidated
+    void flushWrites(const DirectoryEntry& entry, int core, Address blockAddress) {
+        int line = lineOf(blockAddress);
+        unsigned long long& written = lineSharing[core][line].written;
+        if (written) {
+            unsigned long long pending = entry.invalidated & ~(1ULL << core);
+            for (int other = 0; pending; ++other, pending >>= 1) {
+                LineSharing& copy = lineSharing[other][line];
+                if ((pending & 1) && copy.invalidatedBlock == blockAddress) {
+                    copy.missed |= written;
+                }
+            }
+        }
+        written = 0;
+    }
+
+    // Invalidates every copy except the requester's; returns true if one was dirty
+    bool invalidateOthers(Stripe& stripe, DirectoryEntry& entry, int core, Address memoryAddress) {
+        Address blockAddress = memoryAddress >> offsetBits;
+        bool dirtyFound = false;
+        for (int other = 0; other < numCores; ++other) {
+            unsigned long long bit = 1ULL << other;
+            if (other == core || !(entry.sharers & bit)) {
+                continue;
+            }
+            bool dirty = false;
+            flushWrites(entry, other, blockAddress);
+            l1Caches[other].invalidate(memoryAddress, &dirty);
+            LineSharing& copy = lineSharing[other][lineOf(blockAddress)];
+            copy.missed = 0;
+            copy.invalidatedBlock = blockAddress;
+            dirtyFound |= dirty;
+            entry.sharers &= ~bit;
+            entry.invalidated |= bit;
+            stripe.stats.invalidations++;
+        }
+        entry.owner = -1;
+        return dirtyFound;
+    }
+
+    void evictFromL1(int core, const CacheBlock& block, Address blockAddress) {
+        Stripe& stripe = stripeOf(blockAddress);
+        if (block.dirty) {
+            stripe.l2Cache.writeback(sliceAddress(blockAddress << offsetBits));
+            stripe.stats.l1Writebacks++;
+            l1Caches[core].countWriteback();
+        }
+        auto it = stripe.directory.find(blockAddress);
+        if (it == stripe.directory.end()) {
+            lineSharing[core][lineOf(blockAddress)].written = 0;
+            return;
+        }
+        DirectoryEntry& entry = it->second;
+        flushWrites(entry, core, blockAddress);
+        entry.sharers &= ~(1ULL << core);
+        if (entry.owner == core) {
+            entry.owner = -1;
+        }
+        if (!entry.sharers && !entry.invalidated) {
+            stripe.directory.erase(it);
+        }
+    }
+
+    // Drops a core's record of an invalidated copy once its L1 line holds another block,
+    // so the miss can no longer be classified. Both blocks map to the line, and the L1s
+    // index by block address modulo a multiple of the stripe count, so they share a stripe.
+    void forgetInvalidation(Stripe& stripe, int core, Address blockAddress) {
+        auto it = stripe.directory.find(blockAddress);
+        if (it == stripe.directory.end()) {
+            return;
+        }
+        it->second.invalidated &= ~(1ULL << core);
+        if (!it->second.sharers && !it->second.invalidated) {
+            stripe.directory.erase(it);
+        }
+    }
+
+    // A hit that needs no coherence action: a read hit, or a write hit on an E or M
+    // copy. Reads shared state only, so it is safe while no other core changes it.
+    bool isPrivateHit(int core, Address memoryAddress, bool write) {
+        if (!l1Caches[core].contains(memoryAddress)) {
+            return false;
+        }
+        if (!write) {
+            return true;
+        }
+        const auto& directory = stripeOf(memoryAddress >> offsetBits).directory;
+        auto it = directory.find(memoryAddress >> offsetBits);
+        return it != directory.end() && it->second.owner == core;
+    }
+
+    bool accessPrivate(int core, Address memoryAddress, bool write) {
+        bool hit = l1Caches[core].access(memoryAddress, write);
+        if (write) {
+            lineSharing[core][lineOf(memoryAddress >> offsetBits)].written |= wordBit(memoryAddress);
+        }
+        return hit;
+    }
+
+    // Splits the trace into per-core streams, keeping each core's order
+    std::vector<std::vector<TraceRecord>> splitTrace(const std::vector<TraceRecord>& trace) const {
+        std::vector<std::vector<TraceRecord>> streams(numCores);
+        for (const auto& record : trace) {
+            streams[record.core].push_back(record);
+        }
+        return streams;
+    }
+
+public:
+    // 1 to 64 cores, one directory bit each, and L1 blocks of at most 64 words, one
+    // sharing mask bit each; other sizes throw std::invalid_argument.
+    // The stripe count is reduced to a common divisor of the L1 block count and the L2
+    // set count.
+    MultiCoreCache(int numCores, int l1NumBlocks, int l1BlockSize, int l2NumBlocks, int l2BlockSize, int l2Ways,
+                   int lockStripes = 1)
+        : numCores(numCores), l1NumBlocks(l1NumBlocks), offsetBits(blockOffsetBits(l1BlockSize, AddressMode::Word)),
+          wordShift(0) {
+        if (numCores < 1 || numCores > 64) {
+            throw std::invalid_argument("MultiCoreCache supports 1 to 64 cores");
+        }
+        if (l1BlockSize > 64) {
+            throw std::invalid_argument("MultiCoreCache supports L1 blocks of at most 64 words");
+        }
+        numStripes = std::gcd(lockStripes > 1 ? lockStripes : 1, std::gcd(l1NumBlocks, l2NumBlocks / l2Ways));
+        stripes.reserve(numStripes);
+        for (int i = 0; i < numStripes; ++i) {
+            stripes.emplace_back(new Stripe(l2NumBlocks / numStripes, l2BlockSize, l2Ways));
+            // The shared L2 does not prefetch at any stripe count: a next-line prefetch
+            // would land in another stripe's slice, so results would depend on striping
+            stripes[i]->l2Cache.setPrefetchDegree(0);
+        }
+        l1Caches.reserve(numCores);
+        for (int core = 0; core < numCores; ++core) {
+            l1Caches.emplace_back(l1NumBlocks, l1BlockSize);
+            l1Caches[core].onEvict = [this, core](const CacheBlock& block, Address blockAddress) {
+                evictFromL1(core, block, blockAddress);
+            };
+        }
+        coherenceMisses.resize(numCores, 0);
+        lineSharing.resize(numCores, std::vector<LineSharing>(l1NumBlocks, LineSharing{0, 0, InvalidAddress}));
+    }
+
+    MultiCoreCache(const MultiCoreCache&) = delete;
+    MultiCoreCache& operator=(const MultiCoreCache&) = delete;
+
+    // Selects word or byte addresses for every cache; call before the first access
+    void setAddressMode(AddressMode mode) {
+        for (auto& l1 : l1Caches) {
+            l1.setAddressMode(mode);
+        }
+        for (auto& stripe : stripes) {
+            stripe->l2Cache.setAddressMode(mode);
+        }
+        offsetBits = l1Caches[0].getOffsetBits();
+        wordShift = mode == AddressMode::Byte ? 3 : 0;
+    }
+
+    // Returns true if the core's L1 hits. Not thread-safe: the parallel engines call it
+    // under the block's stripe lock or from a serial phase.
+    bool access(int core, Address memoryAddress, bool write) {
+        DirectMappedCache& l1 = l1Caches[core];
+        Address blockAddress = memoryAddress >> offsetBits;
+        unsigned long long bit = 1ULL << core;
+        Stripe& stripe = stripeOf(blockAddress);
+        CoherenceStats& stats = stripe.stats;
+
+        if (l1.contains(memoryAddress)) {
+            if (write) {
+                DirectoryEntry& entry = stripe.directory[blockAddress];
+                if (entry.owner != core) {
+                    // S to M: the other sharers must drop their copies first
+                    stats.upgrades++;
+                    invalidateOthers(stripe, entry, core, memoryAddress);
+                    entry.owner = core;
+                }
+                // E to M is silent
+            }
+            return accessPrivate(core, memoryAddress, write);
+        }
+
+        DirectoryEntry& entry = stripe.directory.emplace(blockAddress, DirectoryEntry{0, -1, 0}).first->second;
+
+        bool supplied = false;
+        if (write) {
+            stats.writeRequests++;
+            supplied = invalidateOthers(stripe, entry, core, memoryAddress);
+        } else {
+            stats.readRequests++;
+            if (entry.owner >= 0 && entry.owner != core) {
+                // The exclusive copy drops to S; dirty data goes to the requester and L2
+                DirectMappedCache& ownerL1 = l1Caches[entry.owner];
+                flushWrites(entry, entry.owner, blockAddress);
+                if (ownerL1.isDirty(memoryAddress)) {
+                    ownerL1.markClean(memoryAddress);
+                    stripe.l2Cache.writeback(sliceAddress(memoryAddress));
+                    stats.l1Writebacks++;
+                    supplied = true;
+                }
+                entry.owner = -1;
+                stats.downgrades++;
+            }
+        }
+        if (supplied) {
+            stats.cacheToCache++;
+        } else {
+            stripe.l2Cache.access(sliceAddress(memoryAddress), false);
+        }
+
+        LineSharing& line = lineSharing[core][lineOf(blockAddress)];
+        if ((entry.invalidated & bit) && line.invalidatedBlock == blockAddress) {
+            // Classified now that every remote write to the block has been published
+            coherenceMisses[core]++;
+            SharingMisses& misses = stripe.sharingMisses.emplace(blockAddress, SharingMisses{0, 0}).first->second;
+            if (line.missed & wordBit(memoryAddress)) {
+                stats.trueSharingMisses++;
+                misses.trueSharing++;
+            } else {
+                stats.falseSharingMisses++;
+                misses.falseSharing++;
+            }
+        }
+        entry.invalidated &= ~bit;
+        if (line.invalidatedBlock != InvalidAddress && line.invalidatedBlock != blockAddress) {
+            forgetInvalidation(stripe, core, line.invalidatedBlock);
+        }
+        line.invalidatedBlock = InvalidAddress;
+
+        accessPrivate(core, memoryAddress, write);
+        entry.sharers |= bit;
+        entry.owner = (write || entry.sharers == bit) ? core : -1;
+        return false;
+    }
+
+    // Every record's core must be below the core count, as readTrace checks
+    void run(const std::vector<TraceRecord>& trace) {
+        for (const auto& record : trace) {
+            access(record.core, record.memoryAddress, record.write);
+        }
+    }
+
+    // Runs each core's part of the trace on its own host thread, with the cores
+    // synchronized every quantum accesses so none runs far ahead of the others.
+    //
+    // Default mode: every access takes its block's stripe lock, so cores only contend
+    // when they touch the same stripe. The interleaving of accesses from different
+    // cores within a quantum depends on host scheduling.
+    //
+    // Deterministic mode: within a quantum, each core runs its private hits in
+    // parallel, without locks, until it reaches an access that needs the shared
+    // levels. The cores then stop at a barrier and those accesses are served
+    // serially in core order, so results do not depend on host timing.
+    void runParallel(const std::vector<TraceRecord>& trace, int quantum, bool deterministic = false) {
+        std::vector<std::vector<TraceRecord>> streams = splitTrace(trace);
+        quantum = quantum > 0 ? quantum : 1;
+        Barrier barrier(numCores);
+        std::vector<size_t> positions(numCores, 0); // Next access of each core
+        std::vector<char> waiting(numCores, 0); // Core stopped at a shared access
+        bool finished = false;
+        std::vector<std::thread> threads;
+        threads.reserve(numCores);
+
+        if (!deterministic) {
+            size_t longest = 0;
+            for (const auto& stream : streams) {
+                longest = stream.size() > longest ? stream.size() : longest;
+            }
+            size_t quanta = (longest + quantum - 1) / quantum;
+            for (int core = 0; core < numCores; ++core) {
+                threads.emplace_back([this, core, quantum, quanta, &streams, &positions, &barrier] {
+                    const std::vector<TraceRecord>& stream = streams[core];
+                    size_t& position = positions[core];
+                    for (size_t q = 0; q < quanta; ++q) {
+                        size_t end = position + quantum < stream.size() ? position + quantum : stream.size();
+                        for (; position < end; ++position) {
+                            const TraceRecord& record = stream[position];
+                            std::lock_guard<std::mutex> guard(stripeOf(record.memoryAddress >> offsetBits).lock);
+                            access(core, record.memoryAddress, record.write);
+                        }
+                        barrier.wait();
+                    }
+                });
+            }
+        } else {
+            for (int core = 0; core < numCores; ++core) {
+                threads.emplace_back([this, core, quantum, &streams, &positions, &waiting, &finished, &barrier] {
+                    const std::vector<TraceRecord>& stream = streams[core];
+                    while (true) {
+                        // Private phase: lock-free, since no core changes shared state
+                        size_t& position = positions[core];
+                        for (int count = 0; count < quantum && position < stream.size(); ++count) {
+                            const TraceRecord& record = stream[position];
+                            if (!isPrivateHit(core, record.memoryAddress, record.write)) {
+                                waiting[core] = 1;
+                                break;
+                            }
+                            accessPrivate(core, record.memoryAddress, record.write);
+                            position++;
+                        }
+                        barrier.wait();
+
+                        // Serial phase, run by core 0
+                        if (core == 0) {
+                            finished = true;
+                            for (int other = 0; other < numCores; ++other) {
+                                if (waiting[other]) {
+                                    const TraceRecord& record = streams[other][positions[other]];
+                                    access(other, record.memoryAddress, record.write);
+                                    positions[other]++;
+                                    waiting[other] = 0;
+                                }
+                                finished &= positions[other] == streams[other].size();
+                            }
+                        }
+                        barrier.wait();
+                        if (finished) {
+                            return;
+                        }
+                    }
+                });
+            }
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Reads "core R|W address" lines (decimal addresses, 64-bit) until the end of input,
+    // skipping blank lines. Returns false on a malformed line or a core this cache does
+    // not have, with the line number and reason in error (if given).
+    bool readTrace(std::istream& in, std::vector<TraceRecord>& trace, std::string* error = nullptr) const {
+        std::string line;
+        int lineNumber = 0;
+        SIM_PROFILE_STAGE(TraceDecode);
+        while (std::getline(in, line)) {
+            lineNumber++;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            std::istringstream fields(line);
+            int core;
+            char op;
+            Address memoryAddress;
+            std::string reason;
+            if (!(fields >> core >> op >> memoryAddress) || (op != 'R' && op != 'W')) {
+                reason = "malformed record";
+            } else if (core < 0 || core >= numCores) {
+                reason = "core " + std::to_string(core) + " out of range (0-" + std::to_string(numCores - 1) + ")";
+            }
+            if (!reason.empty()) {
+                if (error) {
+                    *error = "line " + std::to_string(lineNumber) + ": " + reason;
+                }
+                SIM_PROFILE_STAGE(Outside);
+                return false;
+            }
+            trace.push_back(TraceRecord{core, memoryAddress, op == 'W'});
+        }
+        SIM_PROFILE_STAGE(Outside);
+        return true;
+    }
+
+    int getLockStripes() const {
+        return numStripes;
+    }
+
+    // Registers each core's L1 and the L2 and coherence totals over all stripes
+    void registerStats(StatsRegistry& registry) const {
+        for (int core = 0; core < numCores; ++core) {
+            std::string prefix = "core" + std::to_string(core);
+            l1Caches[core].registerStats(registry, prefix + ".l1");
+            registry.add(prefix + ".coherence_misses", &coherenceMisses[core]);
+        }
+        registry.addCounter("l2.misses", [this] {
+            long long total = 0;
+            for (const auto& stripe : stripes) {
+                total += stripe->l2Cache.getMisses();
+            }
+            return total;
+        });
+        registry.addCounter("l2.searches", [this] {
+            long long total = 0;
+            for (const auto& stripe : stripes) {
+                total += stripe->l2Cache.getSearches();
+            }
+            return total;
+        });
+        registry.addCounter("l2.writebacks", [this] {
+            long long total = 0;
+            for (const auto& stripe : stripes) {
+                total += stripe->l2Cache.getWritebacks();
+            }
+            return total;
+        });
+        const std::pair<const char*, long long CoherenceStats::*> coherenceFields[] = {
+            {"read_requests", &CoherenceStats::readRequests},
+            {"write_requests", &CoherenceStats::writeRequests},
+            {"upgrades", &CoherenceStats::upgrades},
+            {"invalidations", &CoherenceStats::invalidations},
+            {"downgrades", &CoherenceStats::downgrades},
+            {"cache_to_cache", &CoherenceStats::cacheToCache},
+            {"l1_writebacks", &CoherenceStats::l1Writebacks},
+            {"true_sharing_misses", &CoherenceStats::trueSharingMisses},
+            {"false_sharing_misses", &CoherenceStats::falseSharingMisses},
+        };
+        for (const auto& field : coherenceFields) {
+            long long CoherenceStats::*member = field.second;
+            registry.addCounter(std::string("coherence.") + field.first, [this, member] {
+                long long total = 0;
+                for (const auto& stripe : stripes) {
+                    total += stripe->stats.*member;
+                }
+                return total;
+            });
+        }
+    }
+
+    CoherenceState getState(int core, Address memoryAddress) {
+        if (!l1Caches[core].contains(memoryAddress)) {
+            return CoherenceState::Invalid;
+        }
+        const auto& directory = stripeOf(memoryAddress >> offsetBits).directory;
+        auto it = directory.find(memoryAddress >> offsetBits);
+        if (it == directory.end() || it->second.owner != core) {
+            return CoherenceState::Shared;
+        }
+        return l1Caches[core].isDirty(memoryAddress) ? CoherenceState::Modified : CoherenceState::Exclusive;
+    }
+
+    void printStats() const {
+        for (int core = 0; core < numCores; ++core) {
+            l1Caches[core].printStats("Core " + std::to_string(core) + " L1");
+            std::cout << "Coherence Misses: " << coherenceMisses[core] << std::endl;
+        }
+
+        CoherenceStats total = CoherenceStats();
+        long long l2Misses = 0;
+        long long l2Searches = 0;
+        long long l2Writebacks = 0;
+        for (const auto& stripe : stripes) {
+            total.readRequests += stripe->stats.readRequests;
+            total.writeRequests += stripe->stats.writeRequests;
+            total.upgrades += stripe->stats.upgrades;
+            total.invalidations += stripe->stats.invalidations;
+            total.downgrades += stripe->stats.downgrades;
+            total.cacheToCache += stripe->stats.cacheToCache;
+            total.l1Writebacks += stripe->stats.l1Writebacks;
+            total.trueSharingMisses += stripe->stats.trueSharingMisses;
+            total.falseSharingMisses += stripe->stats.falseSharingMisses;
+            l2Misses += stripe->l2Cache.getMisses();
+            l2Searches += stripe->l2Cache.getSearches();
+            l2Writebacks += stripe->l2Cache.getWritebacks();
+        }
+        if (numStripes == 1) {
+            stripes[0]->l2Cache.printStats("Shared L2");
+        } else {
+            std::cout << "Shared L2 Cache Stats (" << numStripes << " slices):" << std::endl;
+            std::cout << "Cache Misses: " << l2Misses << std::endl;
+            std::cout << "Cache Searches: " << l2Searches << std::endl;
+            std::cout << "Cache Hit Rate: " << (1.0 - (double)l2Misses / l2Searches) * 100 << "%" << std::endl;
+            std::cout << "Writebacks: " << l2Writebacks << std::endl;
+        }
+
+        std::cout << "MESI Coherence Stats:" << std::endl;
+        std::cout << "Read Requests: " << total.readRequests << std::endl;
+        std::cout << "Write Requests: " << total.writeRequests << std::endl;
+        std::cout << "Upgrades: " << total.upgrades << std::endl;
+        std::cout << "Invalidations: " << total.invalidations << std::endl;
+        std::cout << "Downgrades: " << total.downgrades << std::endl;
+        std::cout << "Cache-to-Cache Transfers: " << total.cacheToCache << std::endl;
+        std::cout << "L1 Writebacks: " << total.l1Writebacks << std::endl;
+        std::cout << "True Sharing Misses: " << total.trueSharingMisses << std::endl;
+        std::cout << "False Sharing Misses: " << total.falseSharingMisses << std::endl;
+        printSharingReport(10);
+    }
+
+    // Lists the blocks with the most false sharing misses
+    void printSharingReport(int count) const {
+        std::vector<std::pair<Address, SharingMisses>> blocks;
+        for (const auto& stripe : stripes) {
+            for (const auto& block : stripe->sharingMisses) {
+                if (block.second.falseSharing > 0) {
+                    blocks.push_back(block);
+                }
+            }
+        }
+        count = count < (int)blocks.size() ? count : (int)blocks.size();
+        std::partial_sort(blocks.begin(), blocks.begin() + count, blocks.end(),
+                          [](const std::pair<Address, SharingMisses>& a, const std::pair<Address, SharingMisses>& b) {
+                              if (a.second.falseSharing != b.second.falseSharing) {
+                                  return a.second.falseSharing > b.second.falseSharing;
+                              }
+                              return a.first < b.first;
+                          });
+        std::cout << "Top False Sharing Blocks:" << std::endl;
+        for (int i = 0; i < count; ++i) {
+            std::cout << "Address " << (blocks[i].first << offsetBits) << ": " << blocks[i].second.falseSharing
+                      << " false, " << blocks[i].second.trueSharing << " true" << std::endl;
+        }
     }
 };
 
+// Built with -DSIMULATOR_NO_MAIN when the simulator is included by the benchmarks
+#ifndef SIMULATOR_NO_MAIN
 int main() {
     int l1NumBlocks = 128; // 2K words / 16 words per block
     int l1BlockSize = 16;
@@ -489,4 +4558,5 @@ int main() {
     // cache.printCacheState();
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,115 @@
+// Invariant checks for the cache models. Each test prints PASS or FAIL, and the
+// exit status is the number of failures.
+//
+//   g++ -std=c++17 -O2 -pthread -DSIMULATOR_NO_MAIN -o tests tests.cpp
+//   ./tests
+#include <random>
+
+#include "simulator.cpp"
+
+static int failures = 0;
+
+static std::string policyName(WriteHitPolicy hitPolicy, WriteMissPolicy missPolicy) {
+    return std::string(hitPolicy == WriteHitPolicy::WriteBack ? "WB" : "WT") +
+           (missPolicy == WriteMissPolicy::WriteAllocate ? "/WA" : "/NWA");
+}
+
+static void check(const std::string& name, bool passed) {
+    std::cout << (passed ? "PASS: " : "FAIL: ") << name << std::endl;
+    failures += passed ? 0 : 1;
+}
+
+// Under the exclusive policy no block may sit in L1 or the victim cache and in L2 at
+// once, whatever the write policies, write buffer draining or timing model
+static void testExclusion() {
+    const WriteHitPolicy hitPolicies[] = {WriteHitPolicy::WriteBack, WriteHitPolicy::WriteThrough};
+    const WriteMissPolicy missPolicies[] = {WriteMissPolicy::WriteAllocate, WriteMissPolicy::NoWriteAllocate};
+    const int blockSize = 4;
+    const Address rangeWords = 4096 * blockSize;
+
+    for (bool nonBlocking : {false, true}) {
+        for (WriteHitPolicy l1Hit : hitPolicies) {
+            for (WriteMissPolicy l1Miss : missPolicies) {
+                for (WriteHitPolicy l2Hit : hitPolicies) {
+                    for (WriteMissPolicy l2Miss : missPolicies) {
+                        TwoLevelCache cache(64, blockSize, 512, blockSize, 4);
+                        cache.setInclusionPolicy(InclusionPolicy::Exclusive);
+                        cache.setL1WritePolicy(l1Hit, l1Miss);
+                        cache.setL2WritePolicy(l2Hit, l2Miss);
+                        cache.setWriteBuffer(4, 8);
+                        if (nonBlocking) {
+                            cache.setTiming(TimingConfig());
+                            cache.setMSHRs(4, 4);
+                        }
+
+                        std::mt19937_64 rng(7);
+                        bool disjoint = true;
+                        for (int i = 0; i < 50000 && disjoint; ++i) {
+                            // Mostly a hot region that fits in L2, plus a cold tail
+                            Address address = rng() % 4 ? rng() % (rangeWords / 8) : rng() % rangeWords;
+                            cache.access(address, rng() % 3 == 0);
+                            if (i % 1000 == 999) {
+                                for (Address block = 0; block < rangeWords; block += blockSize) {
+                                    if (cache.isHeldAbove(block) && cache.getL2Cache().contains(block)) {
+                                        disjoint = false;
+                                        break;
+                                    }
+                                }
+                            }
+                        }
+                        check(std::string("exclusive L1/victim and L2 disjoint (") +
+                                  (nonBlocking ? "non-blocking" : "blocking") +
+                                  ", L1 " + policyName(l1Hit, l1Miss) +
+                                  ", L2 " + policyName(l2Hit, l2Miss) + ")",
+                              disjoint);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static std::vector<long long> multiCoreStats(const std::vector<TraceRecord>& trace, int lockStripes, bool parallel) {
+    MultiCoreCache cache(4, 128, 16, 1024, 16, 8, lockStripes);
+    if (parallel) {
+        cache.runParallel(trace, 100, true);
+    } else {
+        cache.run(trace);
+    }
+    StatsRegistry registry;
+    cache.registerStats(registry);
+    std::vector<long long> counts;
+    for (size_t i = 0; i < registry.size(); ++i) {
+        if (!registry.isRatio(i)) {
+            counts.push_back(registry.getCount(i));
+        }
+    }
+    return counts;
+}
+
+// The lock stripe count only changes how the directory and L2 are locked, never the
+// simulated results
+static void testStripeIndependence() {
+    std::mt19937_64 rng(11);
+    std::vector<TraceRecord> trace;
+    for (int i = 0; i < 200000; ++i) {
+        int core = (int)(rng() % 4);
+        // Sequential runs per core, with a shared region for coherence traffic
+        Address address = rng() % 4 == 0 ? rng() % 2048 : (Address)core * 100000 + (i / 4) % 20000;
+        trace.push_back(TraceRecord{core, address, rng() % 4 == 0});
+    }
+    for (bool parallel : {false, true}) {
+        std::vector<long long> single = multiCoreStats(trace, 1, parallel);
+        for (int lockStripes : {2, 8}) {
+            check(std::string("multicore stats with 1 and ") + std::to_string(lockStripes) + " stripes match (" +
+                      (parallel ? "deterministic parallel" : "serial") + ")",
+                  multiCoreStats(trace, lockStripes, parallel) == single);
+        }
+    }
+}
+
+int main() {
+    testExclusion();
+    testStripeIndependence();
+    return failures;
+}